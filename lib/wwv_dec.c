@@ -0,0 +1,305 @@
+// Software decoder for WWV frames
+
+/*
+ * Eric Sullivan
+ * Bursts of the 100 Hz subcarrier are joined into pulses, pulses are
+ * sorted by width into zero, one and marker, and each pulse is put in
+ * its second of the frame by walking the layout's table.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "wwv.h"
+#include "wwv_dec.h"
+
+// Edges closer than this belong to the same subcarrier burst (two
+// half cycles)
+#define WWV_DEC_JOIN_NS 15000000ULL
+
+/*
+ * Sets up a decoder for the ECE331 board's layout. frame() is called
+ * for every good frame.
+ */
+void wwv_dec_init(struct wwv_dec *dec, void (*frame)(void *ctx, const struct wwv_frame *f), void *ctx)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->decade = 2020;
+    dec->scale = 1;
+    dec->frame = frame;
+    dec->ctx = ctx;
+    dec->bad = 1;
+    wwv_dec_proto(dec, wwv_proto_get(WWV_PROTO_ECE331));
+}
+
+/*
+ * Switches the decoder to another layout. The pulse order and widths
+ * are worked out from the layout's table. Layouts with blank seconds
+ * start a frame after the gap they leave, the others after two
+ * markers in a row.
+ */
+void wwv_dec_proto(struct wwv_dec *dec, const struct wwv_proto *proto)
+{
+    const struct wwv_sym *sym = proto->sym;
+    int i;
+
+    dec->proto = proto;
+    dec->npulse = 0;
+    dec->markers = 1;
+    dec->lead = 0;
+
+    for (i = 0; i < proto->slots; i++) {
+        if (proto->slot[i].kind == WWV_SLOT_BLANK) {
+            dec->markers = 0;
+            if (dec->npulse == 0)
+                dec->lead += (u64)(sym[WWV_SYM_BLANK].lead_us + sym[WWV_SYM_BLANK].on_us + sym[WWV_SYM_BLANK].off_us) * 1000;
+            continue;
+        }
+        dec->slot[dec->npulse++] = i;
+    }
+
+    // Cut offs half way between the pulse widths
+    dec->one_ns = (u64)(sym[WWV_SYM_ZERO].on_us + sym[WWV_SYM_ONE].on_us) * 500;
+    dec->marker_ns = ~0ULL;
+    if (sym[WWV_SYM_MARKER].on_us)
+        dec->marker_ns = (u64)(sym[WWV_SYM_ONE].on_us + sym[WWV_SYM_MARKER].on_us) * 500;
+
+    // Pulses are a slot apart inside a frame, half a slot more means
+    // a slot was left blank
+    dec->quiet_ns = (u64)(sym[WWV_SYM_ZERO].lead_us + sym[WWV_SYM_ZERO].on_us + sym[WWV_SYM_ZERO].off_us) * 1500;
+
+    // Only a subcarrier burst has edges inside a pulse
+    dec->join_ns = (proto->level == WWV_LVL_CARRIER) ? WWV_DEC_JOIN_NS : 0;
+
+    dec->bad = 1;
+    dec->seen = 0;
+}
+
+/*
+ * Returns the value of a BCD field, one digit per 4 bits.
+ */
+static int wwv_dec_bcd(int bcd)
+{
+    return (bcd & 0xf) + 10 * ((bcd >> 4) & 0xf) + 100 * ((bcd >> 8) & 0xf);
+}
+
+/*
+ * Works out the day of the year for layouts that send the month and
+ * day of the month instead.
+ */
+static int wwv_dec_yday(int year, int mon, int mday)
+{
+    static const int mdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    int yday = mday;
+    int m;
+
+    for (m = 1; m < mon && m <= 12; m++) yday += mdays[m - 1] + (m == 2 && leap);
+
+    return yday;
+}
+
+/*
+ * Checks every second of a full frame against the layout and hands
+ * the date to the caller.
+ */
+static void wwv_dec_frame(struct wwv_dec *dec)
+{
+    const struct wwv_proto *proto = dec->proto;
+    const struct wwv_slot *s;
+    struct wwv_frame f;
+    u8 sym[WWV_SLOTS_MAX];
+    int bcd[WWV_FIELDS];
+    int bin[WWV_FIELDS];
+    u8 binary[WWV_FIELDS];
+    int year_tens = 0;
+    int has_yday = 0;
+    int has_sec = 0;
+    int ones;
+    int ok;
+    int i;
+    int j;
+
+    memset(&f, 0, sizeof(f));
+    memset(bcd, 0, sizeof(bcd));
+    memset(bin, 0, sizeof(bin));
+    memset(binary, 0, sizeof(binary));
+
+    // Put the pulses back in their seconds
+    for (i = 0; i < proto->slots; i++) sym[i] = WWV_SYM_BLANK;
+    for (i = 0; i < dec->npulse; i++) sym[dec->slot[i]] = dec->sym[i];
+
+    for (i = 0; i < proto->slots; i++) {
+        s = &proto->slot[i];
+        switch (s->kind) {
+            case WWV_SLOT_ZERO:
+                ok = (sym[i] == WWV_SYM_ZERO);
+                break;
+
+            case WWV_SLOT_ONE:
+                ok = (sym[i] == WWV_SYM_ONE);
+                break;
+
+            case WWV_SLOT_MARKER:
+                ok = (sym[i] == WWV_SYM_MARKER);
+                break;
+
+            case WWV_SLOT_FIELD:
+                ok = (sym[i] != WWV_SYM_MARKER);
+                if (sym[i] == WWV_SYM_ONE) bcd[s->field] |= 1 << s->bit;
+                if (s->field == WWV_F_YEAR && s->bit >= 4) year_tens = 1;
+                if (s->field == WWV_F_YDAY) has_yday = 1;
+                if (s->field == WWV_F_SEC) has_sec = 1;
+                break;
+
+            case WWV_SLOT_BINARY:
+                ok = (sym[i] != WWV_SYM_MARKER);
+                if (sym[i] == WWV_SYM_ONE) bin[s->field] |= 1 << s->bit;
+                binary[s->field] = 1;
+                break;
+
+            case WWV_SLOT_PARITY:
+                // Ones over the run and the parity bit must be even
+                ones = (sym[i] == WWV_SYM_ONE);
+                for (j = s->field; j < s->field + s->bit; j++) ones += (sym[j] == WWV_SYM_ONE);
+                ok = (sym[i] != WWV_SYM_MARKER) && !(ones & 1);
+                break;
+
+            default:
+                ok = 1;
+                break;
+        }
+        if (!ok) {
+            if (!dec->partial) dec->errors++;
+            return;
+        }
+    }
+
+    for (i = 0; i < WWV_FIELDS; i++) f.field[i] = binary[i] ? bin[i] : wwv_dec_bcd(bcd[i]);
+
+    // The first pulse comes its symbol's lead in after its second starts
+    f.start = dec->first - dec->lead - (u64)proto->sym[dec->sym[0]].lead_us * 1000;
+    if (year_tens) {
+        f.year = dec->decade / 100 * 100 + f.field[WWV_F_YEAR];
+    } else {
+        f.year = dec->decade + f.field[WWV_F_YEAR];
+    }
+    f.sec = has_sec ? f.field[WWV_F_SEC] : -1;
+    f.min = f.field[WWV_F_MIN];
+    f.hour = f.field[WWV_F_HOUR];
+    if (has_yday) {
+        f.yday = f.field[WWV_F_YDAY];
+    } else {
+        f.yday = wwv_dec_yday(f.year, f.field[WWV_F_MON], f.field[WWV_F_MDAY]);
+    }
+
+    dec->frames++;
+    if (dec->frame) dec->frame(dec->ctx, &f);
+}
+
+/*
+ * Sorts a finished pulse by width and adds it to the frame.
+ */
+static void wwv_dec_pulse(struct wwv_dec *dec, u64 rise, u64 width)
+{
+    int sym;
+    int sync;
+
+    if (width < dec->one_ns) {
+        sym = WWV_SYM_ZERO;
+    } else if (width < dec->marker_ns) {
+        sym = WWV_SYM_ONE;
+    } else {
+        sym = WWV_SYM_MARKER;
+    }
+
+    // A frame starts on its sync. The first pulse of the input (the
+    // first marker, for layouts synced by markers) is tried as a frame
+    // start too, but it may be mid frame so it isn't an error if that
+    // doesn't work out.
+    if (dec->markers) {
+        sync = (sym == WWV_SYM_MARKER && (!dec->seen || dec->last_sym == WWV_SYM_MARKER));
+    } else {
+        sync = (!dec->seen || rise - dec->last > dec->quiet_ns);
+    }
+    if (sync) {
+        if (!dec->bad && !dec->partial) dec->errors++;
+        dec->partial = !dec->seen;
+        dec->nsym = 0;
+        dec->bad = 0;
+        dec->first = rise;
+    }
+    dec->seen = 1;
+    dec->last = rise;
+    dec->last_sym = sym;
+
+    if (dec->bad) return;
+
+    // More pulses than a frame holds
+    if (dec->nsym >= dec->npulse) {
+        if (!dec->partial) dec->errors++;
+        dec->bad = 1;
+        return;
+    }
+
+    dec->sym[dec->nsym++] = sym;
+
+    // Frame is complete, wait for the next sync
+    if (dec->nsym == dec->npulse) {
+        wwv_dec_frame(dec);
+        dec->bad = 1;
+    }
+}
+
+/*
+ * Feeds one pin transition to the decoder. Edges must come in time
+ * order.
+ */
+void wwv_dec_edge(struct wwv_dec *dec, u64 t, int level)
+{
+    level = level ? 1 : 0;
+    if (level == dec->level) return;
+    dec->level = level;
+
+    // Back to real time, so the layout's widths apply as they are
+    t *= dec->scale;
+
+    if (level) {
+        // A rise after a gap ends the last pulse and starts a new one
+        if (dec->in_pulse && t - dec->fall > dec->join_ns) {
+            wwv_dec_pulse(dec, dec->rise, dec->fall - dec->rise);
+            dec->in_pulse = 0;
+        }
+        if (!dec->in_pulse) {
+            dec->in_pulse = 1;
+            dec->rise = t;
+        }
+    } else {
+        dec->fall = t;
+    }
+}
+
+/*
+ * Ends the input, so a pulse still open is counted. A frame cut off
+ * by the end of the input is dropped without counting an error.
+ */
+void wwv_dec_finish(struct wwv_dec *dec)
+{
+    if (dec->in_pulse && dec->level == 0) {
+        wwv_dec_pulse(dec, dec->rise, dec->fall - dec->rise);
+        dec->in_pulse = 0;
+    }
+    dec->bad = 1;
+}
+
+/*
+ * Prints a frame the way the expansion board does, with the second
+ * on the end for formats that send it.
+ */
+int wwv_dec_format(const struct wwv_frame *f, char *buf, int len)
+{
+    if (f->sec >= 0)
+        return snprintf(buf, len, "Year %d DoY %03d Hour %02d Minute %02d Second %02d",
+            f->year, f->yday, f->hour, f->min, f->sec);
+
+    return snprintf(buf, len, "Year %d DoY %03d Hour %02d Minute %02d",
+        f->year, f->yday, f->hour, f->min);
+}
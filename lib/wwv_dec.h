@@ -0,0 +1,68 @@
+// Software decoder for WWV frames
+
+/*
+ * Eric Sullivan
+ * Recovers the pulses, markers and BCD fields from an edge trace,
+ * doing the same job as the ECE331 expansion board. Any layout the
+ * encoder has a table for can be decoded.
+ */
+#ifndef WWV_DEC_H
+#define WWV_DEC_H
+
+#include "wwv_enc.h"
+
+// A decoded frame
+struct wwv_frame {
+    u64 start;			// Time of second 0 in ns
+    int year;			// Full year
+    int yday;			// Day of year as sent
+    int hour;
+    int min;
+    int sec;			// Second for formats that send it, -1 otherwise
+    int field[WWV_FIELDS];	// Every field the layout carries, BCD decoded
+};
+
+// Decoder state, fed one edge at a time
+struct wwv_dec {
+    const struct wwv_proto *proto;	// Layout being decoded
+    int decade;			// Added to the sent year digit, e.g. 2020
+    u32 scale;			// Time compression of the input, 1 for real time
+    void (*frame)(void *ctx, const struct wwv_frame *f);	// Called per good frame
+    void *ctx;			// Passed back to frame()
+    unsigned long frames;	// Good frames decoded
+    unsigned long errors;	// Frames thrown away
+
+    // Worked out from the layout
+    int npulse;			// Pulses in a frame
+    int markers;		// Set if frames start after two markers, not a gap
+    u8 slot[WWV_SLOTS_MAX];	// Slot each pulse of a frame is in
+    u64 lead;			// Time from second 0 to the second of the first pulse
+    u64 one_ns;			// Pulses at least this wide are ones
+    u64 marker_ns;		// Pulses at least this wide are markers
+    u64 quiet_ns;		// Gap between pulses that means a blank slot
+    u64 join_ns;		// Edges closer than this are one pulse
+
+    // Pulse tracking
+    int level;			// Last level seen
+    int in_pulse;		// Set between the first rise and the gap after it
+    u64 rise;			// Start of the current pulse
+    u64 fall;			// Last fall in the current pulse
+    int seen;			// Set once a pulse has been seen
+    u64 last;			// Start of the last finished pulse
+    int last_sym;		// Kind of the last finished pulse
+
+    // Frame assembly
+    int nsym;			// Pulses collected for this frame
+    int bad;			// Set if this frame can't be used
+    int partial;		// Set if the frame didn't start on a sync
+    u64 first;			// Start of the first pulse in the frame
+    u8 sym[WWV_SLOTS_MAX];	// Pulse kinds in the order they came
+};
+
+void wwv_dec_init(struct wwv_dec *dec, void (*frame)(void *ctx, const struct wwv_frame *f), void *ctx);
+void wwv_dec_proto(struct wwv_dec *dec, const struct wwv_proto *proto);
+void wwv_dec_edge(struct wwv_dec *dec, u64 t, int level);
+void wwv_dec_finish(struct wwv_dec *dec);
+int wwv_dec_format(const struct wwv_frame *f, char *buf, int len);
+
+#endif	// WWV_DEC_H
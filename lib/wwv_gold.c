@@ -0,0 +1,300 @@
+// Golden edge trace corpus for the WWV encoder core
+
+/*
+ * Eric Sullivan
+ * A corpus file is text so it diffs and reviews well. After a
+ * "WWVG version format" line each frame is a "frame stamp flags" line,
+ * a line per slot and an "end" line. A slot line is the slot's symbol
+ * (0, 1, M or - for blank) and its length in us, then the gap in us
+ * before each edge in the slot, from the slot start or the edge before
+ * it. A gap repeated n times is written gap*n, so a subcarrier burst
+ * is one word. Every edge flips the pin, starting from low.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "wwv_gold.h"
+
+// Symbol letters, indexed by WWV_SYM_*
+static const char wwv_gold_sym[WWV_SYMS] = { '0', '1', 'M', '-' };
+
+/*
+ * Sets up an empty corpus.
+ */
+void wwv_gold_init(struct wwv_gold *g)
+{
+    memset(g, 0, sizeof(*g));
+}
+
+/*
+ * Frees the frames and edges held by a corpus.
+ */
+void wwv_gold_free(struct wwv_gold *g)
+{
+    free(g->frame);
+    free(g->edge);
+    wwv_gold_init(g);
+}
+
+/*
+ * Writes a stamp as the ISO 8601 ordinal date wwv_parse_iso() reads.
+ */
+void wwv_gold_format_stamp(const struct wwv_stamp *stamp, char *buf, size_t len)
+{
+    snprintf(buf, len, "%04d-%03uT%02u:%02u:%02uZ", stamp->year, stamp->yday, stamp->hour, stamp->min, stamp->sec);
+}
+
+/*
+ * Writes the line that starts a corpus file.
+ * Returns 0 on success, 1 on a write error.
+ */
+int wwv_gold_header(FILE *fp, const struct wwv_proto *proto)
+{
+    return fprintf(fp, "WWVG %d %s\n", WWV_GOLD_VERSION, proto->name) < 0;
+}
+
+/*
+ * Writes one frame to a corpus file. The edges are the frame as
+ * recorded on its own, starting from 0. Returns 0 on success, 1 if
+ * the stamp is not valid, the edges don't flip the pin each time or
+ * on a write error.
+ */
+int wwv_gold_write_frame(FILE *fp, const struct wwv_proto *proto, const struct wwv_stamp *stamp,
+                         const struct wwv_edge *edge, size_t len)
+{
+    struct wwv_date dtime;
+    const struct wwv_sym *sym;
+    char iso[32];
+    u64 start = 0;
+    u64 end;
+    u64 prev;
+    u64 gap;
+    size_t i = 0;
+    size_t n;
+    int level = 1;
+    int s;
+    int k;
+
+    if (wwv_conv_stamp(stamp, &dtime)) return 1;
+
+    wwv_gold_format_stamp(stamp, iso, sizeof(iso));
+    fprintf(fp, "frame %s 0x%02x\n", iso, stamp->flags);
+
+    for (s = 0; s < proto->slots; s++) {
+        k = wwv_slot_sym(proto, s, &dtime);
+        sym = &proto->sym[k];
+        end = start + (u64)(sym->lead_us + sym->on_us + sym->off_us) * 1000;
+        fprintf(fp, "%c %u", wwv_gold_sym[k], sym->lead_us + sym->on_us + sym->off_us);
+
+        // The last slot takes any edge on the frame's end
+        prev = start;
+        while (i < len && (edge[i].t < end || s == proto->slots - 1)) {
+            // Frames at real time only have whole us edges
+            gap = edge[i].t - prev;
+            if (gap % 1000) return 1;
+            for (n = 1; i + n < len && edge[i + n].t - edge[i + n - 1].t == gap &&
+                        (edge[i + n].t < end || s == proto->slots - 1); n++);
+            fprintf(fp, n > 1 ? " %llu*%zu" : " %llu", (unsigned long long)gap / 1000, n);
+
+            for (; n > 0; n--, i++) {
+                if ((int)edge[i].level != level) return 1;
+                level = !level;
+            }
+            prev = edge[i - 1].t;
+        }
+        fputc('\n', fp);
+        start = end;
+    }
+
+    return fprintf(fp, "end\n") < 0;
+}
+
+/*
+ * Appends an edge to the corpus, growing it if needed.
+ * Returns 0 on success, 1 if out of memory.
+ */
+static int wwv_gold_add_edge(struct wwv_gold *g, u64 t, int level, int slot)
+{
+    struct wwv_gold_edge *edge;
+    size_t cap;
+
+    if (g->edges == g->edge_cap) {
+        cap = g->edge_cap ? g->edge_cap * 2 : 4096;
+        edge = realloc(g->edge, cap * sizeof(struct wwv_gold_edge));
+        if (edge == NULL) return 1;
+        g->edge = edge;
+        g->edge_cap = cap;
+    }
+
+    g->edge[g->edges].t = t;
+    g->edge[g->edges].level = level;
+    g->edge[g->edges].slot = slot;
+    g->edges++;
+
+    return 0;
+}
+
+/*
+ * Starts a new frame in the corpus from its "frame" line.
+ * Returns the frame, NULL if the line is bad or out of memory.
+ */
+static struct wwv_gold_frame *wwv_gold_add_frame(struct wwv_gold *g, char *line)
+{
+    struct wwv_gold_frame *frame;
+    char *iso = strtok(line + 5, " \t\n");
+    char *flags = strtok(NULL, " \t\n");
+    size_t cap;
+
+    if (g->frames == g->frame_cap) {
+        cap = g->frame_cap ? g->frame_cap * 2 : 256;
+        frame = realloc(g->frame, cap * sizeof(struct wwv_gold_frame));
+        if (frame == NULL) return NULL;
+        g->frame = frame;
+        g->frame_cap = cap;
+    }
+
+    frame = &g->frame[g->frames];
+    memset(frame, 0, sizeof(*frame));
+    if (iso == NULL || flags == NULL || wwv_parse_iso(iso, strlen(iso), &frame->stamp)) return NULL;
+    frame->stamp.flags = strtoul(flags, NULL, 0);
+    frame->first = g->edges;
+    g->frames++;
+
+    return frame;
+}
+
+/*
+ * Reads a whole corpus file. Returns 0 on success, 1 if the file is
+ * not a corpus, is cut short or out of memory.
+ */
+int wwv_gold_read(struct wwv_gold *g, FILE *fp)
+{
+    struct wwv_gold_frame *frame = NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    char name[32];
+    char *p;
+    char *sym;
+    unsigned long long gap;
+    unsigned long n;
+    u64 start = 0;
+    u64 t = 0;
+    int version;
+    int level = 1;
+    int slot = 0;
+    int ret = 1;
+
+    while (getline(&line, &cap, fp) > 0) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        if (g->proto == NULL) {
+            if (sscanf(line, "WWVG %d %31s", &version, name) != 2 || version != WWV_GOLD_VERSION) goto out;
+            g->proto = wwv_proto_find(name);
+            if (g->proto == NULL) goto out;
+        } else if (strncmp(line, "frame ", 6) == 0) {
+            if (frame != NULL) goto out;
+            frame = wwv_gold_add_frame(g, line);
+            if (frame == NULL) goto out;
+            start = 0;
+            level = 1;
+            slot = 0;
+        } else if (strncmp(line, "end", 3) == 0) {
+            if (frame == NULL || slot != g->proto->slots) goto out;
+            frame->count = g->edges - frame->first;
+            frame = NULL;
+        } else {
+            // A slot: symbol, length, then the gaps before its edges
+            if (frame == NULL || slot >= g->proto->slots) goto out;
+            sym = memchr(wwv_gold_sym, line[0], WWV_SYMS);
+            if (sym == NULL) goto out;
+            frame->sym[slot] = sym - wwv_gold_sym;
+
+            p = line + 1;
+            t = start;
+            start += strtoull(p, &p, 10) * 1000;
+            while (*p == ' ') {
+                gap = strtoull(p, &p, 10) * 1000;
+                n = 1;
+                if (*p == '*') n = strtoul(p + 1, &p, 10);
+                for (; n > 0; n--) {
+                    t += gap;
+                    if (wwv_gold_add_edge(g, t, level, slot)) goto out;
+                    level = !level;
+                }
+            }
+            slot++;
+        }
+    }
+
+    // A frame left open means the file was cut short
+    if (g->proto != NULL && frame == NULL && !ferror(fp)) ret = 0;
+
+out:
+    free(line);
+    return ret;
+}
+
+// Fills in where a trace left the corpus
+static void wwv_gold_mismatch(struct wwv_gold_diff *res, long frame, int slot, size_t edge,
+                              long long want_ns, int want_level, long long got_ns, int got_level)
+{
+    res->frame = frame;
+    res->slot = slot;
+    res->edge = edge;
+    res->want_ns = want_ns;
+    res->want_level = want_level;
+    res->got_ns = got_ns;
+    res->got_level = got_level;
+}
+
+/*
+ * Compares a trace against the corpus, frame by frame. Each frame of
+ * the trace is lined up on its own first edge, so how far apart the
+ * frames are doesn't matter. Every other edge has to be at the
+ * golden time, divided by scale, give or take tol_ns. Returns 0 if the
+ * trace matches, 1 otherwise with the first difference in res.
+ */
+int wwv_gold_diff(const struct wwv_gold *g, const struct wwv_edge *edge, size_t len,
+                  u64 tol_ns, u32 scale, struct wwv_gold_diff *res)
+{
+    const struct wwv_gold_frame *fr;
+    const struct wwv_gold_edge *ge;
+    long long origin = 0;
+    long long want;
+    long long got;
+    size_t pos = 0;
+    size_t f;
+    size_t i;
+
+    memset(res, 0, sizeof(*res));
+    res->frame = -1;
+    if (scale == 0) scale = 1;
+
+    for (f = 0; f < g->frames; f++) {
+        fr = &g->frame[f];
+        ge = &g->edge[fr->first];
+        if (pos < len && fr->count) origin = (long long)edge[pos].t - (long long)(ge[0].t / scale);
+
+        for (i = 0; i < fr->count; i++) {
+            want = ge[i].t / scale;
+            if (pos + i >= len) {
+                wwv_gold_mismatch(res, f, ge[i].slot, i, want, ge[i].level, -1, 0);
+                return 1;
+            }
+            got = (long long)edge[pos + i].t - origin;
+            if ((int)edge[pos + i].level != ge[i].level || llabs(got - want) > (long long)tol_ns) {
+                wwv_gold_mismatch(res, f, ge[i].slot, i, want, ge[i].level, got, edge[pos + i].level);
+                return 1;
+            }
+        }
+        pos += fr->count;
+        res->matched++;
+    }
+
+    // The trace goes on past the last golden frame
+    if (pos < len) {
+        wwv_gold_mismatch(res, g->frames, -1, 0, -1, 0, (long long)edge[pos].t - origin, edge[pos].level);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Golden edge trace corpus for the WWV encoder core
+
+/*
+ * Eric Sullivan
+ * Reads and writes the golden corpus, a text file of reference
+ * frames with every edge they make split up by slot, and diffs a
+ * recorded or captured trace against it.
+ */
+#ifndef WWV_GOLD_H
+#define WWV_GOLD_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+
+// Corpus file format version, on its WWVG line
+#define WWV_GOLD_VERSION 1
+
+// One edge of a golden frame
+struct wwv_gold_edge {
+    u64 t;			// ns from the start of the frame
+    int level;			// Level the pin went to
+    int slot;			// Slot the edge belongs to
+};
+
+// One golden frame, its edges are edge[first] to edge[first + count - 1]
+struct wwv_gold_frame {
+    struct wwv_stamp stamp;	// Frame it was recorded for
+    char sym[WWV_SLOTS_MAX];	// WWV_SYM_* of each slot
+    size_t first;		// First edge in the corpus
+    size_t count;		// Edges in the frame
+};
+
+// A whole corpus for one frame layout
+struct wwv_gold {
+    const struct wwv_proto *proto;	// Layout the frames are in
+    struct wwv_gold_frame *frame;	// Frames in file order
+    size_t frames;		// Frames in use
+    size_t frame_cap;		// Frames allocated
+    struct wwv_gold_edge *edge;	// Edges of every frame
+    size_t edges;		// Edges in use
+    size_t edge_cap;		// Edges allocated
+};
+
+// Where a trace first left the corpus
+struct wwv_gold_diff {
+    size_t matched;		// Frames that matched whole
+    long frame;			// Frame it happened in, -1 if the trace matched
+    int slot;			// Slot of the golden edge, -1 if the trace ran on past it
+    size_t edge;		// Edge in the frame
+    long long want_ns;		// Golden edge time in the frame, -1 if none
+    long long got_ns;		// Trace edge time in the frame, -1 if none
+    int want_level;		// Golden edge level
+    int got_level;		// Trace edge level
+};
+
+void wwv_gold_init(struct wwv_gold *g);
+void wwv_gold_free(struct wwv_gold *g);
+int wwv_gold_header(FILE *fp, const struct wwv_proto *proto);
+int wwv_gold_write_frame(FILE *fp, const struct wwv_proto *proto, const struct wwv_stamp *stamp,
+                         const struct wwv_edge *edge, size_t len);
+int wwv_gold_read(struct wwv_gold *g, FILE *fp);
+int wwv_gold_diff(const struct wwv_gold *g, const struct wwv_edge *edge, size_t len,
+                  u64 tol_ns, u32 scale, struct wwv_gold_diff *res);
+void wwv_gold_format_stamp(const struct wwv_stamp *stamp, char *buf, size_t len);
+
+#endif	// WWV_GOLD_H
@@ -0,0 +1,153 @@
+// Recording backend for the WWV encoder core
+
+/*
+ * Eric Sullivan
+ * Backend that stores every pin transition with its time, so the
+ * encoder can be checked and benchmarked without the hardware.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "wwv_rec.h"
+
+/*
+ * Sets up an empty trace.
+ */
+void wwv_trace_init(struct wwv_trace *tr)
+{
+    memset(tr, 0, sizeof(*tr));
+}
+
+/*
+ * Frees the edges held by a trace.
+ */
+void wwv_trace_free(struct wwv_trace *tr)
+{
+    free(tr->edge);
+    wwv_trace_init(tr);
+}
+
+/*
+ * Empties a trace but keeps its memory for reuse.
+ */
+void wwv_trace_reset(struct wwv_trace *tr)
+{
+    tr->len = 0;
+    tr->base = 0;
+    tr->now = 0;
+    tr->level = 0;
+    tr->err = 0;
+}
+
+/*
+ * Appends an edge to the trace, growing it if needed.
+ * Returns 0 on success, 1 if out of memory.
+ */
+int wwv_trace_add(struct wwv_trace *tr, u64 t, int level)
+{
+    struct wwv_edge *edge;
+    size_t cap;
+
+    if (tr->len == tr->cap) {
+        cap = tr->cap ? tr->cap * 2 : 4096;
+        edge = realloc(tr->edge, cap * sizeof(struct wwv_edge));
+        if (edge == NULL) {
+            tr->err = 1;
+            return 1;
+        }
+        tr->edge = edge;
+        tr->cap = cap;
+    }
+
+    tr->edge[tr->len].t = t;
+    tr->edge[tr->len].level = level;
+    tr->edge[tr->len].pad = 0;
+    tr->len++;
+
+    return 0;
+}
+
+// Backend call to set the pin, only real transitions are stored
+static void wwv_rec_set_pin(void *ctx, int level)
+{
+    struct wwv_trace *tr = ctx;
+
+    if (level == tr->level) return;
+    tr->level = level;
+    wwv_trace_add(tr, tr->base + tr->now, level);
+}
+
+// Backend call to wait, the clock just jumps ahead
+static void wwv_rec_wait_until(void *ctx, u64 t)
+{
+    struct wwv_trace *tr = ctx;
+
+    tr->now = t;
+}
+
+/*
+ * Fills in a backend that records into the trace.
+ */
+void wwv_rec_backend(struct wwv_trace *tr, struct wwv_backend *be)
+{
+    be->set_pin = wwv_rec_set_pin;
+    be->wait_until = wwv_rec_wait_until;
+    be->ctx = tr;
+}
+
+/*
+ * Records a frame onto the end of the trace, starting where the last
+ * recorded frame ended, at the trace's time scale. Returns 0 on success, 1 if out of memory.
+ */
+int wwv_rec_frame(struct wwv_trace *tr, const struct wwv_sched *sched)
+{
+    struct wwv_backend be;
+
+    wwv_rec_backend(tr, &be);
+    tr->now = 0;
+    wwv_play_scaled(sched, &be, tr->scale);
+    tr->base += tr->now;
+    tr->now = 0;
+
+    return tr->err;
+}
+
+/*
+ * Writes a trace file: the header then the edges as stored.
+ * Returns 0 on success, 1 on a write error.
+ */
+int wwv_trace_write(const struct wwv_trace *tr, FILE *fp)
+{
+    u32 version = WWV_TRACE_VERSION;
+
+    if (fwrite(WWV_TRACE_MAGIC, 4, 1, fp) != 1) return 1;
+    if (fwrite(&version, sizeof(version), 1, fp) != 1) return 1;
+    if (tr->len && fwrite(tr->edge, sizeof(struct wwv_edge), tr->len, fp) != tr->len) return 1;
+
+    return 0;
+}
+
+/*
+ * Reads a whole trace file, appending its edges to the trace.
+ * Returns 0 on success, 1 if the file is not a trace or is cut short.
+ */
+int wwv_trace_read(struct wwv_trace *tr, FILE *fp)
+{
+    char magic[4];
+    u32 version;
+    struct wwv_edge edge[1024];
+    size_t n;
+    size_t i;
+
+    if (fread(magic, 4, 1, fp) != 1 || memcmp(magic, WWV_TRACE_MAGIC, 4)) return 1;
+    if (fread(&version, sizeof(version), 1, fp) != 1 || version != WWV_TRACE_VERSION) return 1;
+
+    while ((n = fread(edge, sizeof(struct wwv_edge), 1024, fp)) > 0) {
+        for (i = 0; i < n; i++) {
+            if (wwv_trace_add(tr, edge[i].t, edge[i].level)) return 1;
+        }
+    }
+    if (ferror(fp)) return 1;
+    if (tr->len) tr->level = tr->edge[tr->len - 1].level;
+
+    return 0;
+}
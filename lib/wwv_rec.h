@@ -0,0 +1,36 @@
+// Recording backend for the WWV encoder core
+
+/*
+ * Eric Sullivan
+ * Plays schedules into an in-memory edge trace instead of a pin,
+ * and reads/writes traces as files.
+ */
+#ifndef WWV_REC_H
+#define WWV_REC_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "wwv_enc.h"
+
+// Edge trace recorded from the encoder
+struct wwv_trace {
+    struct wwv_edge *edge;	// Recorded edges
+    size_t len;			// Edges in use
+    size_t cap;			// Edges allocated
+    u64 base;			// Start of the frame being recorded
+    u64 now;			// Backend clock, ns from base
+    int level;			// Current pin level
+    u32 scale;			// Time compression frames are recorded at, 0 for none
+    int err;			// Set if an edge could not be stored
+};
+
+void wwv_trace_init(struct wwv_trace *tr);
+void wwv_trace_free(struct wwv_trace *tr);
+void wwv_trace_reset(struct wwv_trace *tr);
+int wwv_trace_add(struct wwv_trace *tr, u64 t, int level);
+void wwv_rec_backend(struct wwv_trace *tr, struct wwv_backend *be);
+int wwv_rec_frame(struct wwv_trace *tr, const struct wwv_sched *sched);
+int wwv_trace_write(const struct wwv_trace *tr, FILE *fp);
+int wwv_trace_read(struct wwv_trace *tr, FILE *fp);
+
+#endif	// WWV_REC_H
@@ -0,0 +1,154 @@
+/*
+ * Eric Sullivan
+ * Cancel test for the wwv driver, two cases:
+ * - blank: sends an ece331 frame with WWV_TRANSMIT and cancels it
+ *   with WWV_CANCEL in the trailing blank (seconds 45-59), where the
+ *   pin is low for the rest of the minute.
+ * - start: sends a frame with WWV_TRANSMIT_AT a few seconds ahead and
+ *   cancels it before its first edge.
+ * In both the sender must get ECANCELED at once, not at the end of
+ * the blank or after the frame's start.
+ * Usage: canceltest [device] [scale], default /dev/wwv0 at 10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "wwv.h"
+
+// Second of the frame the blank case cancels in
+#define CANCEL_SEC 52
+
+// How far ahead the start case schedules its frame, and when it
+// cancels it, in ms
+#define START_MS 3000
+#define START_CANCEL_MS 1000
+
+// Longest the sender may take to come back after the cancel
+#define LIMIT_MS 20
+
+static int fd;
+static int tx_ret;
+static int tx_errno;
+static struct timespec tx_end;
+
+// Sends one frame with WWV_TRANSMIT and notes when and how it came back
+static void *send_frame(void *arg)
+{
+    tx_ret = ioctl(fd, WWV_TRANSMIT, arg);
+    tx_errno = errno;
+    clock_gettime(CLOCK_MONOTONIC, &tx_end);
+
+    return NULL;
+}
+
+// Same with WWV_TRANSMIT_AT
+static void *send_frame_at(void *arg)
+{
+    tx_ret = ioctl(fd, WWV_TRANSMIT_AT, arg);
+    tx_errno = errno;
+    clock_gettime(CLOCK_MONOTONIC, &tx_end);
+
+    return NULL;
+}
+
+// ms from a to b
+static double elapsed_ms(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/*
+ * Starts send on arg, cancels the pin after wait_us and checks how the
+ * sender came back. Returns 0 if it passed.
+ */
+static int run_case(const char *name, void *(*send)(void *), void *arg, useconds_t wait_us, int scale)
+{
+    struct timespec t0, t1;
+    pthread_t tid;
+    double ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (pthread_create(&tid, NULL, send, arg) != 0) {
+        printf("%s: cannot start the sender\n", name);
+        return 1;
+    }
+
+    usleep(wait_us);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (ioctl(fd, WWV_CANCEL, WWV_CANCEL_PIN) < 0) perror("ioctl() failure\n");
+    pthread_join(tid, NULL);
+
+    ms = elapsed_ms(&t1, &tx_end);
+    if (tx_ret == 0) {
+        printf("%s: frame was not cancelled, it ended %.3f ms after the cancel\n", name, ms);
+        return 1;
+    }
+    if (tx_errno != ECANCELED) {
+        printf("%s: frame failed with %s\n", name, strerror(tx_errno));
+        return 1;
+    }
+    printf("%s: cancelled at %.3f s, sender back %.3f ms later\n", name,
+        elapsed_ms(&t0, &t1) * scale / 1e3, ms);
+    if (ms > LIMIT_MS) {
+        printf("%s: sender waited, over %d ms\n", name, LIMIT_MS);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/wwv0";
+    int scale = argc > 2 ? atoi(argv[2]) : 10;
+    struct timespec now;
+    struct wwv_at at;
+    struct tm utc;
+    int ret = 0;
+
+    if (scale < 1 || scale > WWV_SCALE_MAX) {
+        printf("Usage: canceltest [device] [scale]\n");
+        return 1;
+    }
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    if (ioctl(fd, WWV_SET_PROTO, WWV_PROTO_ECE331) < 0 || ioctl(fd, WWV_SET_SCALE, scale) < 0) {
+        perror("ioctl() failure\n");
+        close(fd);
+        return 1;
+    }
+
+    memset(&utc, 0, sizeof(utc));
+    utc.tm_year = 120;
+    utc.tm_yday = 108;
+    utc.tm_hour = 12;
+    utc.tm_min = 34;
+
+    // Well into the blank, far from both its ends
+    ret |= run_case("blank", send_frame, &utc, CANCEL_SEC * 1000000 / scale, scale);
+
+    memset(&at, 0, sizeof(at));
+    at.stamp.year = 2020;
+    at.stamp.yday = 108;
+    at.stamp.hour = 12;
+    at.stamp.min = 35;
+    at.clock = CLOCK_REALTIME;
+    clock_gettime(CLOCK_REALTIME, &now);
+    at.start_ns = (long long)now.tv_sec * 1000000000 + now.tv_nsec + (long long)START_MS * 1000000;
+    ret |= run_case("start", send_frame_at, &at, START_CANCEL_MS * 1000, 1);
+
+    ioctl(fd, WWV_SET_SCALE, 1);
+    close(fd);
+    return ret;
+}
@@ -0,0 +1,272 @@
+/*
+ * Eric Sullivan
+ * Encoder benchmark for the wwv driver:
+ * runs the encoder core from libwwv.a over every valid date,
+ * checks the frames and reports how many frames per second
+ * it can compile and record. Every layout is also run through
+ * the decoder to check it decodes back to what was sent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_rec.h"
+#include "wwv_dec.h"
+
+// Frames per layout in the round trip check
+#define TRIP_FRAMES 1500
+
+// Dates sent in the round trip check and how many came back right
+struct trip {
+    const struct wwv_proto *proto;
+    struct wwv_date sent[TRIP_FRAMES];
+    int next;
+    int bad;
+};
+
+// Seconds from a timespec pair
+static double elapsed(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+// Fills in a struct tm from frame number n, walking every valid date
+static void frame_date(long n, struct tm *utc)
+{
+    memset(utc, 0, sizeof(*utc));
+    utc->tm_min = n % 60;
+    utc->tm_hour = (n / 60) % 24;
+    utc->tm_yday = (n / 1440) % 367;
+    utc->tm_year = 120 + (n / (1440 * 367)) % 10;
+}
+
+// Checks a decoded frame sends the same symbols as the one sent
+static void trip_frame(void *ctx, const struct wwv_frame *f)
+{
+    struct trip *t = ctx;
+    struct wwv_date got;
+    int i;
+
+    memcpy(got.field, f->field, sizeof(got.field));
+    got.field[WWV_F_YDAY] = f->yday;
+    for (i = 0; i < t->proto->slots; i++) {
+        if (t->next >= TRIP_FRAMES ||
+            wwv_slot_sym(t->proto, i, &got) != wwv_slot_sym(t->proto, i, &t->sent[t->next])) {
+            t->bad++;
+            break;
+        }
+    }
+    t->next++;
+}
+
+// Text times write() takes, and what they should parse to
+static const struct {
+    const char *text;
+    int ok;
+    int year, yday, hour, min, sec;
+} iso[] = {
+    { "2020-04-17T12:34Z", 1, 2020, 108, 12, 34, 0 },
+    { "2020-108T12:34:56Z", 1, 2020, 108, 12, 34, 56 },
+    { "2024-12-31 23:59:60", 1, 2024, 366, 23, 59, 60 },
+    { "2023-03-01T00:00", 1, 2023, 60, 0, 0, 0 },
+    { "2023-02-29T00:00Z", 0 },
+    { "2020-13-01T00:00Z", 0 },
+    { "2020-04-17T12:3Z", 0 },
+    { "2020-04-17T12:34Zjunk", 0 },
+    { "20-04-17T12:34Z", 0 },
+};
+
+// Checks the ISO 8601 parser against the table above
+static int check_iso(void)
+{
+    struct wwv_stamp st;
+    int ok;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(iso) / sizeof(iso[0])); i++) {
+        ok = wwv_parse_iso(iso[i].text, strlen(iso[i].text), &st) == 0;
+        if (ok != iso[i].ok || (ok && (st.year != iso[i].year || st.yday != iso[i].yday ||
+            st.hour != iso[i].hour || st.min != iso[i].min || st.sec != iso[i].sec))) {
+            printf("ISO time %s parsed wrong!\n", iso[i].text);
+            return 1;
+        }
+    }
+
+    printf("ISO times: %d parsed right\n", i);
+    return 0;
+}
+
+// Checks every symbol of every layout is exactly one slot long, so
+// each second (or IRIG-B slot) starts on time and not just the frame
+static int check_slots(void)
+{
+    const struct wwv_proto *proto;
+    const struct wwv_sym *sym;
+    int p;
+    int s;
+
+    for (p = 0; (proto = wwv_proto_get(p)) != NULL; p++) {
+        for (s = 0; s < WWV_SYMS; s++) {
+            sym = &proto->sym[s];
+            // A layout without the symbol leaves it empty
+            if (sym->lead_us + sym->on_us + sym->off_us == 0) continue;
+            if ((u64)(sym->lead_us + sym->on_us + sym->off_us) * proto->slots != proto->period_us) {
+                printf("%s symbol %d is %u us, not a slot of %u us!\n", proto->name, s,
+                    sym->lead_us + sym->on_us + sym->off_us, proto->period_us / proto->slots);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Sends a run of frames over a new year with a leap day in every
+// layout, with the DST, leap second and DUT1 fields changing, and
+// decodes them back at the same time scale
+static int check_protos(u32 scale)
+{
+    static struct trip t;
+    const struct wwv_proto *proto;
+    struct wwv_trace tr;
+    struct wwv_sched sched;
+    struct wwv_dec dec;
+    struct tm utc;
+    time_t start;
+    time_t when;
+    int *f;
+    int p;
+    int i;
+
+    memset(&utc, 0, sizeof(utc));
+    utc.tm_year = 123;
+    utc.tm_mon = 11;
+    utc.tm_mday = 31;
+    utc.tm_hour = 23;
+    start = timegm(&utc);
+
+    for (p = 0; (proto = wwv_proto_get(p)) != NULL; p++) {
+        memset(&t, 0, sizeof(t));
+        t.proto = proto;
+        wwv_trace_init(&tr);
+        tr.scale = scale;
+        for (i = 0; i < TRIP_FRAMES; i++) {
+            // Every 10th frame jumps to the next day to get past the leap day
+            when = start + (i % 10) * 61 + (i / 10) * 86400;
+            gmtime_r(&when, &utc);
+            utc.tm_yday++;
+            wwv_conv_date(&utc, &t.sent[i]);
+            f = t.sent[i].field;
+            f[WWV_F_DST1] = i & 1;
+            f[WWV_F_STD] = !f[WWV_F_DST1];
+            f[WWV_F_DST2] = (i >> 1) & 1;
+            f[WWV_F_LSW] = (i >> 2) & 1;
+            f[WWV_F_DUT1] = i % 10;
+            f[WWV_F_DUT1_NEG] = (i >> 3) & 1;
+            f[WWV_F_DUT1_POS] = !f[WWV_F_DUT1_NEG];
+            if (wwv_enc_frame(&sched, proto, &t.sent[i]) || wwv_rec_frame(&tr, &sched)) {
+                printf("%s frame %d did not encode!\n", proto->name, i);
+                return 1;
+            }
+
+            // Frames must fill the period exactly or they slip against UTC
+            if (wwv_sched_ns(&sched) != (u64)proto->period_us * 1000) {
+                printf("%s frame %d is %llu ns, not %u us!\n", proto->name, i,
+                    (unsigned long long)wwv_sched_ns(&sched), proto->period_us);
+                return 1;
+            }
+        }
+
+        wwv_dec_init(&dec, trip_frame, &t);
+        wwv_dec_proto(&dec, proto);
+        dec.scale = scale;
+        for (i = 0; i < tr.len; i++) wwv_dec_edge(&dec, tr.edge[i].t, tr.edge[i].level);
+        wwv_dec_finish(&dec);
+        wwv_trace_free(&tr);
+
+        printf("Round trip %s x%u: %lu of %d frames, %lu errors, %d wrong\n",
+            proto->name, scale, dec.frames, TRIP_FRAMES, dec.errors, t.bad);
+        if (dec.frames != TRIP_FRAMES || dec.errors || t.bad) return 1;
+    }
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    long frames;
+    long i;
+    long edges = 0;
+    u64 frame_ns = 0;
+    struct tm utc;
+    struct wwv_date dtime;
+    struct wwv_sched sched;
+    struct wwv_trace tr;
+    struct timespec t0, t1;
+    double secs;
+
+    // Defaults to every date in a year with a leap day
+    if (argc < 2) {
+        frames = 1440 * 367;
+    } else {
+        frames = atol(argv[1]);
+    }
+
+    // Out of range dates must be refused
+    memset(&utc, 0, sizeof(utc));
+    utc.tm_min = 60;
+    if (wwv_conv_date(&utc, &dtime) == 0) {
+        printf("Minute 60 was accepted!\n");
+        return 1;
+    }
+
+    // Compile only
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < frames; i++) {
+        frame_date(i, &utc);
+        if (wwv_conv_date(&utc, &dtime) || wwv_enc_date(&sched, &dtime)) {
+            printf("Frame %ld did not encode!\n", i);
+            return 1;
+        }
+        if (i == 0) frame_ns = wwv_sched_ns(&sched);
+        if (wwv_sched_ns(&sched) != frame_ns) {
+            printf("Frame %ld is %llu ns, not %llu ns!\n", i,
+                (unsigned long long)wwv_sched_ns(&sched), (unsigned long long)frame_ns);
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = elapsed(&t0, &t1);
+    printf("Compile: %ld frames in %.3f s, %.0f frames/s\n", frames, secs, frames / secs);
+
+    // Compile and record the edges
+    wwv_trace_init(&tr);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < frames; i++) {
+        frame_date(i, &utc);
+        wwv_conv_date(&utc, &dtime);
+        wwv_enc_date(&sched, &dtime);
+        wwv_trace_reset(&tr);
+        if (wwv_rec_frame(&tr, &sched)) {
+            printf("Out of memory recording frame %ld!\n", i);
+            return 1;
+        }
+        if (tr.base != frame_ns || tr.level != 0) {
+            printf("Frame %ld recorded wrong!\n", i);
+            return 1;
+        }
+        edges += tr.len;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = elapsed(&t0, &t1);
+    printf("Record: %ld frames in %.3f s, %.0f frames/s, %.0f edges/s\n",
+        frames, secs, frames / secs, edges / secs);
+    printf("Frame length %.3f s\n", frame_ns / 1e9);
+
+    wwv_trace_free(&tr);
+
+    return check_iso() || check_slots() || check_protos(1) || check_protos(WWV_SCALE_MAX);
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Eric Sullivan
+# Checks the encoder against the golden corpus: records every frame
+# in tests/golden/cases.txt in every format and diffs it against
+# tests/golden/<format>.gold with no tolerance. With -r the corpus is
+# written again from the current encoder instead, for a change to the
+# frames that is meant. Build the tools (make -C tools) first.
+# Usage: golden.sh [-r]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+TOOLS="$DIR/../tools"
+FAILED=0
+
+for PROTO in ece331 wwv wwvb dcf77 irigb; do
+    GOLD="$DIR/golden/$PROTO.gold"
+    if [ "$1" = "-r" ]; then
+        "$TOOLS/wwvrec" -g -p "$PROTO" -i "$DIR/golden/cases.txt" -o "$GOLD" || exit 1
+        echo "Wrote $GOLD"
+    else
+        "$TOOLS/wwvrec" -p "$PROTO" -i "$DIR/golden/cases.txt" | "$TOOLS/wwvdiff" "$GOLD" || FAILED=1
+    fi
+done
+
+exit $FAILED
@@ -0,0 +1,205 @@
+/*
+ * Eric Sullivan
+ * Pin fast path test for the wwv driver:
+ * points the driver's GPSET/GPCLR pin code at a mock register
+ * block, checks every pin lands in the right bank and bit, plays
+ * a frame of every layout through it and checks the pin makes the
+ * same edges as the recorder, then reports the cost of an edge.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wwv_enc.h"
+#include "wwv_pin.h"
+#include "wwv_rec.h"
+
+// Mock of the BCM283x GPIO block. Writes land in reg[] like any
+// other memory, mock_apply() then acts on them the way the hardware
+// does and clears them again.
+struct mock_gpio {
+    uint32_t reg[WWV_GPIO_REGS / 4];	// The mapped block
+    uint32_t lev[2];			// Pin levels, like GPLEV0/1
+};
+
+// Backend that drives one mock pin and records what it does
+struct mock_be {
+    struct mock_gpio *gpio;
+    struct wwv_mmio_pin pin;
+    unsigned int gpio_nr;
+    struct wwv_trace tr;
+    u64 now;
+};
+
+// Seconds from a timespec pair
+static double elapsed(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+// Applies any set/clear writes to the pin levels
+static void mock_apply(struct mock_gpio *m)
+{
+    uint32_t *set;
+    uint32_t *clr;
+    int bank;
+
+    for (bank = 0; bank < 2; bank++) {
+        set = &m->reg[WWV_GPSET0 / 4 + bank];
+        clr = &m->reg[WWV_GPCLR0 / 4 + bank];
+        m->lev[bank] = (m->lev[bank] | *set) & ~*clr;
+        *set = 0;
+        *clr = 0;
+    }
+}
+
+// Level of one mock pin
+static int mock_level(struct mock_gpio *m, unsigned int gpio)
+{
+    return (m->lev[gpio / 32] >> (gpio % 32)) & 1;
+}
+
+// Backend call to set the pin, through the register fast path
+static void mock_set_pin(void *ctx, int level)
+{
+    struct mock_be *mb = ctx;
+    int was = mock_level(mb->gpio, mb->gpio_nr);
+
+    wwv_mmio_pin_set(&mb->pin, level);
+    mock_apply(mb->gpio);
+    if (mock_level(mb->gpio, mb->gpio_nr) != was) wwv_trace_add(&mb->tr, mb->now, !was);
+}
+
+// Backend call to wait, the clock just jumps ahead
+static void mock_wait_until(void *ctx, u64 t)
+{
+    struct mock_be *mb = ctx;
+
+    mb->now = t;
+}
+
+// Every pin sets and clears only its own bit
+static int check_pins(void)
+{
+    static struct mock_gpio m;
+    struct wwv_mmio_pin pin;
+    uint32_t want[2];
+    unsigned int gpio;
+
+    // Start with every other pin high so stray bits show up
+    m.lev[0] = 0x55555555;
+    m.lev[1] = 0x00155555;
+    for (gpio = 0; gpio < WWV_GPIO_PINS; gpio++) {
+        if (wwv_mmio_pin_init(&pin, m.reg, gpio)) {
+            printf("Pin %u was refused!\n", gpio);
+            return 1;
+        }
+        want[0] = m.lev[0];
+        want[1] = m.lev[1];
+
+        wwv_mmio_pin_set(&pin, 1);
+        mock_apply(&m);
+        want[gpio / 32] |= 1U << (gpio % 32);
+        if (m.lev[0] != want[0] || m.lev[1] != want[1]) {
+            printf("Setting pin %u went wrong!\n", gpio);
+            return 1;
+        }
+
+        wwv_mmio_pin_set(&pin, 0);
+        mock_apply(&m);
+        want[gpio / 32] &= ~(1U << (gpio % 32));
+        if (m.lev[0] != want[0] || m.lev[1] != want[1]) {
+            printf("Clearing pin %u went wrong!\n", gpio);
+            return 1;
+        }
+    }
+    if (wwv_mmio_pin_init(&pin, m.reg, WWV_GPIO_PINS) == 0) {
+        printf("Pin %d was accepted!\n", WWV_GPIO_PINS);
+        return 1;
+    }
+
+    printf("Pins: all %d set and clear their own bit\n", WWV_GPIO_PINS);
+    return 0;
+}
+
+// A frame of every layout makes the same edges on the mock pin as
+// in the recorder
+static int check_frames(void)
+{
+    static struct mock_gpio m;
+    const struct wwv_proto *proto;
+    struct wwv_backend be;
+    struct mock_be mb;
+    struct wwv_trace tr;
+    struct wwv_sched sched;
+    struct wwv_date dtime;
+    struct tm utc;
+    int p;
+
+    memset(&utc, 0, sizeof(utc));
+    utc.tm_year = 124;
+    utc.tm_yday = 60;
+    utc.tm_hour = 23;
+    utc.tm_min = 59;
+    wwv_conv_date(&utc, &dtime);
+
+    memset(&mb, 0, sizeof(mb));
+    mb.gpio = &m;
+    mb.gpio_nr = 17;
+    wwv_mmio_pin_init(&mb.pin, m.reg, mb.gpio_nr);
+    be.set_pin = mock_set_pin;
+    be.wait_until = mock_wait_until;
+    be.ctx = &mb;
+
+    for (p = 0; (proto = wwv_proto_get(p)) != NULL; p++) {
+        if (wwv_enc_frame(&sched, proto, &dtime)) {
+            printf("%s frame did not encode!\n", proto->name);
+            return 1;
+        }
+        wwv_trace_init(&tr);
+        wwv_trace_init(&mb.tr);
+        wwv_rec_frame(&tr, &sched);
+        wwv_play(&sched, &be);
+
+        if (tr.err || mb.tr.err || tr.len != mb.tr.len ||
+            memcmp(tr.edge, mb.tr.edge, tr.len * sizeof(struct wwv_edge)) != 0) {
+            printf("%s: pin made different edges than the recorder!\n", proto->name);
+            return 1;
+        }
+        printf("Frame %s: %zu edges match\n", proto->name, tr.len);
+        wwv_trace_free(&tr);
+        wwv_trace_free(&mb.tr);
+    }
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    static struct mock_gpio m;
+    struct wwv_mmio_pin pin;
+    struct timespec t0, t1;
+    long edges;
+    long i;
+    double secs;
+
+    if (argc < 2) {
+        edges = 100000000;
+    } else {
+        edges = atol(argv[1]);
+    }
+
+    if (check_pins() || check_frames()) return 1;
+
+    // Cost of the edge itself off-target, a store to the mock block.
+    // On the Pi the posted write to the GPIO block is what's left.
+    wwv_mmio_pin_init(&pin, m.reg, 17);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < edges; i++) wwv_mmio_pin_set(&pin, i & 1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = elapsed(&t0, &t1);
+    printf("Edges: %ld in %.3f s, %.2f ns/edge\n", edges, secs, secs * 1e9 / edges);
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Eric Sullivan
+ * Transmit benchmark for the wwv driver on the simulated board:
+ * queues a run of consecutive frames on a channel at a time scale,
+ * waits for them to go out, then decodes the channel's debugfs edge
+ * log and checks every frame came back. Reports the throughput and
+ * the engine's lateness and frame length histograms.
+ * Usage: simbench [device] [frames] [scale], see simbench.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <time.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_rec.h"
+#include "wwv_dec.h"
+
+// Frames checked against what was sent
+struct sent {
+    time_t start;		// Time of the first frame
+    long step;			// Seconds between frames
+    long frames;		// Frames sent
+    long next;			// Next frame expected back
+    long bad;			// Frames that came back wrong
+};
+
+// Seconds from a timespec pair
+static double elapsed(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+// Reads one line of a sysfs or debugfs file, 0 on success
+static int read_line(const char *path, char *buf, int len)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) return 1;
+    if (fgets(buf, len, fp) == NULL) buf[0] = 0;
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = 0;
+
+    return 0;
+}
+
+// Copies a debugfs file to stdout
+static void show(const char *path)
+{
+    char buf[256];
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) return;
+    while (fgets(buf, sizeof(buf), fp) != NULL) fputs(buf, stdout);
+    fclose(fp);
+}
+
+// Checks a decoded frame is the next one sent
+static void check_frame(void *ctx, const struct wwv_frame *f)
+{
+    struct sent *s = ctx;
+    time_t t = s->start + s->next * s->step;
+    struct tm utc;
+
+    gmtime_r(&t, &utc);
+    if (s->next >= s->frames || f->year != utc.tm_year + 1900 || f->yday != utc.tm_yday + 1 ||
+        f->hour != utc.tm_hour || f->min != utc.tm_min || (f->sec >= 0 && f->sec != utc.tm_sec)) {
+        s->bad++;
+    }
+    s->next++;
+}
+
+int main (int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/wwv0";
+    long frames = argc > 2 ? atol(argv[2]) : 64;
+    long scale = argc > 3 ? atol(argv[3]) : 100;
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    char file[256];
+    char buf[64];
+    const struct wwv_proto *proto;
+    struct wwv_batch batch;
+    struct wwv_status st;
+    struct pollfd pfd;
+    struct timespec t0, t1;
+    struct sent sent;
+    struct wwv_trace tr;
+    struct wwv_dec dec;
+    struct tm utc;
+    time_t t;
+    FILE *fp;
+    __u64 done;
+    double secs;
+    int fd;
+    long i;
+    int j;
+
+    // The channel's format decides how far apart the frames are
+    snprintf(file, sizeof(file), "/sys/class/wwv_class/%s/protocol", name);
+    if (read_line(file, buf, sizeof(buf)) || (proto = wwv_proto_find(buf)) == NULL) {
+        printf("Cannot read the format of %s\n", name);
+        return 1;
+    }
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    if (ioctl(fd, WWV_SET_SCALE, (int)scale) < 0) {
+        perror("WWV_SET_SCALE");
+        close(fd);
+        return 1;
+    }
+
+    // Empty the edge log so it only holds this run
+    snprintf(file, sizeof(file), "/sys/kernel/debug/wwv/%s/edges", name);
+    wwv_trace_init(&tr);
+    fp = fopen(file, "rb");
+    if (fp == NULL) {
+        printf("No edge log, load wwv.ko with edge_log set\n");
+        close(fd);
+        return 1;
+    }
+    wwv_trace_read(&tr, fp);
+    fclose(fp);
+    wwv_trace_reset(&tr);
+
+    // Start the histograms over too
+    snprintf(buf, sizeof(buf), "/sys/kernel/debug/wwv/%s/reset", name);
+    fp = fopen(buf, "w");
+    if (fp != NULL) {
+        fputs("1\n", fp);
+        fclose(fp);
+    }
+
+    // Consecutive frames from the next whole minute
+    memset(&sent, 0, sizeof(sent));
+    sent.start = (time(NULL) / 60 + 1) * 60;
+    sent.step = proto->period_us / 1000000;
+    sent.frames = frames;
+    ioctl(fd, WWV_STATUS, &st);
+    done = st.completed + frames;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < frames; i += batch.count) {
+        memset(&batch, 0, sizeof(batch));
+        batch.version = WWV_BATCH_VERSION;
+        batch.count = frames - i < WWV_BATCH_MAX ? frames - i : WWV_BATCH_MAX;
+        for (j = 0; j < (int)batch.count; j++) {
+            t = sent.start + (i + j) * sent.step;
+            gmtime_r(&t, &utc);
+            batch.stamps[j].year = utc.tm_year + 1900;
+            batch.stamps[j].yday = utc.tm_yday + 1;
+            batch.stamps[j].hour = utc.tm_hour;
+            batch.stamps[j].min = utc.tm_min;
+            batch.stamps[j].sec = utc.tm_sec;
+        }
+        if (ioctl(fd, WWV_TRANSMIT_BATCH, &batch) < 0) {
+            perror("WWV_TRANSMIT_BATCH");
+            close(fd);
+            return 1;
+        }
+    }
+
+    // Waits for the driver to report the frames as sent
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    do {
+        if (poll(&pfd, 1, -1) < 0 || ioctl(fd, WWV_STATUS, &st) < 0) {
+            perror("Waiting for frames");
+            close(fd);
+            return 1;
+        }
+    } while (st.completed < done);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ioctl(fd, WWV_SET_SCALE, 1);
+    close(fd);
+
+    secs = elapsed(&t0, &t1);
+    printf("Sent %ld %s frames at x%ld in %.3f s, %.1f frames/s (%.3f s expected)\n",
+        frames, proto->name, scale, secs, frames / secs,
+        frames * (proto->period_us / 1e6) / scale);
+
+    // Decode what the pin did
+    fp = fopen(file, "rb");
+    if (fp == NULL || wwv_trace_read(&tr, fp)) {
+        printf("Cannot read %s\n", file);
+        return 1;
+    }
+    fclose(fp);
+
+    wwv_dec_init(&dec, check_frame, &sent);
+    wwv_dec_proto(&dec, proto);
+    dec.scale = scale;
+    gmtime_r(&sent.start, &utc);
+    dec.decade = (utc.tm_year + 1900) / 10 * 10;
+    for (i = 0; i < (long)tr.len; i++) wwv_dec_edge(&dec, tr.edge[i].t, tr.edge[i].level);
+    wwv_dec_finish(&dec);
+    printf("Decoded %lu of %ld frames from %zu edges, %lu errors, %ld wrong\n",
+        dec.frames, frames, tr.len, dec.errors, sent.bad);
+    wwv_trace_free(&tr);
+
+    snprintf(file, sizeof(file), "/sys/kernel/debug/wwv/%s/edges_dropped", name);
+    if (read_line(file, buf, sizeof(buf)) == 0 && atol(buf) != 0) printf("Edge log dropped %s edges\n", buf);
+
+    snprintf(file, sizeof(file), "/sys/kernel/debug/wwv/%s/lateness", name);
+    show(file);
+    snprintf(file, sizeof(file), "/sys/kernel/debug/wwv/%s/frame", name);
+    show(file);
+
+    return dec.frames != (unsigned long)frames || dec.errors || sent.bad;
+}
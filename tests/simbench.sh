@@ -0,0 +1,31 @@
+#!/bin/sh
+# Eric Sullivan
+# Runs the driver on a simulated board and benchmarks a transmit run:
+# loads gpio-mockup for the pins, wwv.ko with the edge log on and
+# wwv_sim.ko to probe it, then runs simbench on /dev/wwv0 and
+# canceltest on /dev/wwv1, which cancels in a blank and before a
+# first edge.
+# gpio-mockup lines may sleep, so the driver sets them from a work item
+# (pin_backend gpiod-cansleep) while the edge log is still written from
+# the hrtimer. The numbers are the timer engine's, not the line's.
+# Needs root, debugfs and a kernel with gpio-mockup. Build the modules
+# (make) and the tests (make -C tests) first.
+# Usage: simbench.sh [frames] [scale] [format]
+
+FRAMES=${1:-64}
+SCALE=${2:-100}
+PROTO=${3:-ece331}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+set -e
+modprobe gpio-mockup gpio_mockup_ranges=-1,5
+insmod "$DIR/../wwv.ko" edge_log=262144
+insmod "$DIR/../wwv_sim.ko"
+trap 'rmmod wwv_sim; rmmod wwv; rmmod gpio-mockup' EXIT
+
+# udev may still be making the node
+while [ ! -c /dev/wwv0 ]; do sleep 0.1; done
+echo "$PROTO" > /sys/class/wwv_class/wwv0/protocol
+echo "Pin backend: $(cat /sys/class/wwv_class/wwv0/pin_backend)"
+"$DIR/simbench" /dev/wwv0 "$FRAMES" "$SCALE"
+"$DIR/canceltest" /dev/wwv1
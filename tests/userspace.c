@@ -4,6 +4,7 @@
  * Test 1 for wwv kernel drive:
  * gets current UTC date and time and
  * sends it to driver
+ * Usage: userspace [device], default /dev/wwv0
  */
 
 #include <stdio.h>
@@ -12,15 +13,23 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <time.h>
 #include "wwv.h"
 
+// Frames sent per run, the test script reads this many lines back
+#define FRAMES 2
+
 int main (int argc, char *argv[])
 {
     int fd;
+    int i;
+    const char *path = argc > 1 ? argv[1] : "/dev/wwv0";
     time_t t;
     struct tm *utc;
-    pid_t pid;
+    struct pollfd pfd;
+    struct wwv_status st;
+    __u64 done;
 
     // Gets the current time
     t = time(NULL);
@@ -31,38 +40,45 @@ int main (int argc, char *argv[])
     printf("Year %d DoY %d ", utc->tm_year + 1900, utc->tm_yday);
     printf("Hour %d Minute %d\n", utc->tm_hour, utc->tm_min);
     
-    fd = open("/dev/wwv", O_WRONLY);
+    fd = open(path, O_WRONLY | O_NONBLOCK);
     if (fd < 0) {
-        printf("Cannot open wwv\n");
+        printf("Cannot open %s\n", path);
         return 1;
     }
 
-    pid = fork();
+    // Marks where the completion count starts
+    if (ioctl(fd, WWV_STATUS, &st) < 0) {
+        printf("Error! Could not acces driver!\n");
+        close(fd);
+        return 1;
+    }
+    done = st.completed + FRAMES;
 
-    // Parent Process
-    if (pid > 0) {
-        if (ioctl(fd, WWV_TRANSMIT, utc) < 0) {
+    // Queues the frames, the driver sends them back to back
+    for (i = 0; i < FRAMES; i++) {
+        if (ioctl(fd, WWV_SUBMIT, utc) < 0) {
             printf("Error! Could not acces driver!\n");
             close(fd);
             return 1;
         }
+    }
 
-    // Child Process
-    } else if (pid == 0) {
-        if (ioctl(fd, WWV_TRANSMIT, utc) < 0) {
+    // Waits for the driver to report the frames as sent
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (st.completed < done) {
+        if (poll(&pfd, 1, -1) < 0) {
+            perror("poll() failure\n");
+            close(fd);
+            return 1;
+        }
+        if (ioctl(fd, WWV_STATUS, &st) < 0) {
             printf("Error! Could not acces driver!\n");
             close(fd);
             return 1;
         }
-    
-    // Error if forking fails
-    } else {
-        perror("fork() failure\n");
-        close(fd);
-        return 1;
     }
 
     close(fd);
     return 0;
 }
-
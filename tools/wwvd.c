@@ -0,0 +1,350 @@
+/*
+ * Eric Sullivan
+ * Transmit daemon for the wwv driver:
+ * holds /dev/wwvN open and sends a frame for every frame period
+ * (a minute, or a second for IRIG-B) for as long as it runs. A
+ * timerfd wakes it a lead time ahead of each boundary and the frame
+ * is handed to the driver with WWV_TRANSMIT_AT, so the first edge is
+ * placed on the boundary by the kernel's hrtimer. Timing and miss
+ * counts are written to a state file after every frame.
+ * Usage: wwvd [-l lead_ms] [-s state_file] [-n frames] [device]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+
+// Frames that can be on their way to the driver at once. Each one
+// waits its turn for the pin, so more than two means the pin is stuck.
+#define INFLIGHT_MAX 4
+
+#define NSEC 1000000000LL
+
+// Counters written to the state file
+struct metrics {
+    long long sent;		// Frames sent whole
+    long long missed;		// Boundaries that got no frame
+    long long errors;		// Frames the driver refused
+    long long lead_ns;		// Last time from handing over a frame to its boundary
+    long long lead_min_ns;	// Shortest of those
+    long long submit_ns;	// Last delay from the planned wakeup to the hand over
+    long long submit_max_ns;	// Longest of those
+    long long late_ns;		// Last delay of the first edge, from the driver
+    long long late_max_ns;	// Longest of those
+    long long last_start;	// Boundary of the last frame sent, s since the epoch
+    char last_error[64];	// Why the last frame failed
+};
+
+// One frame on its way to the driver
+struct job {
+    struct wwv_at at;		// Frame and its boundary
+    long long wake_ns;		// When the daemon meant to hand it over
+};
+
+static int fd;
+static const char *dev_path = "/dev/wwv0";
+static const char *state_path = "/run/wwvd.state";
+static const struct wwv_proto *proto;
+static struct metrics m;
+static int inflight;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;	// Protects m and inflight
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;	// Signalled as inflight drops
+
+static void usage(void)
+{
+    printf("Usage: wwvd [-l lead_ms] [-s state_file] [-n frames] [device]\n");
+}
+
+// CLOCK_REALTIME in ns
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+// Writes the metrics out, replacing the state file in one step so a
+// reader never sees half of it. Called with lock held.
+static void write_state(void)
+{
+    char tmp[256];
+    char when[32];
+    time_t t = m.last_start;
+    struct tm utc;
+    FILE *fp;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", state_path);
+    fp = fopen(tmp, "w");
+    if (fp == NULL) return;
+
+    gmtime_r(&t, &utc);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    fprintf(fp, "device %s\nformat %s\n", dev_path, proto->name);
+    fprintf(fp, "updated %lld\n", now_ns() / NSEC);
+    fprintf(fp, "sent %lld\nmissed %lld\nerrors %lld\n", m.sent, m.missed, m.errors);
+    fprintf(fp, "last_frame %s\n", m.last_start ? when : "-");
+    fprintf(fp, "lead_ns %lld\nlead_min_ns %lld\n", m.lead_ns, m.lead_min_ns);
+    fprintf(fp, "submit_latency_ns %lld\nsubmit_latency_max_ns %lld\n", m.submit_ns, m.submit_max_ns);
+    fprintf(fp, "late_ns %lld\nlate_max_ns %lld\n", m.late_ns, m.late_max_ns);
+    fprintf(fp, "last_error %s\n", m.last_error[0] ? m.last_error : "-");
+
+    if (fclose(fp) == 0) rename(tmp, state_path);
+}
+
+// Hands one frame to the driver and waits for it to be sent
+static void *send_frame(void *arg)
+{
+    struct job *job = arg;
+    long long t0 = now_ns();
+    int ret;
+
+    ret = ioctl(fd, WWV_TRANSMIT_AT, &job->at);
+
+    pthread_mutex_lock(&lock);
+    m.lead_ns = job->at.start_ns - t0;
+    if (m.lead_min_ns == 0 || m.lead_ns < m.lead_min_ns) m.lead_min_ns = m.lead_ns;
+    m.submit_ns = t0 - job->wake_ns;
+    if (m.submit_ns > m.submit_max_ns) m.submit_max_ns = m.submit_ns;
+
+    if (ret == 0) {
+        m.sent++;
+        m.last_start = job->at.start_ns / NSEC;
+        m.late_ns = job->at.late_ns;
+        if (m.late_ns > m.late_max_ns) m.late_max_ns = m.late_ns;
+    } else if (errno == ETIME) {
+        // The pin came free too late for this boundary
+        m.missed++;
+        snprintf(m.last_error, sizeof(m.last_error), "%s", strerror(errno));
+    } else if (errno != EINTR && errno != ECANCELED) {
+        m.errors++;
+        snprintf(m.last_error, sizeof(m.last_error), "%s", strerror(errno));
+    }
+    write_state();
+    inflight--;
+    pthread_cond_signal(&idle);
+    pthread_mutex_unlock(&lock);
+
+    free(job);
+    return NULL;
+}
+
+// Starts a thread to send the frame for the boundary at start_ns.
+// Returns 0 if it was started.
+static int start_frame(long long start_ns, long long wake_ns)
+{
+    struct job *job;
+    pthread_t tid;
+    time_t t = start_ns / NSEC;
+    struct tm utc;
+
+    job = calloc(1, sizeof(struct job));
+    if (job == NULL) return 1;
+
+    gmtime_r(&t, &utc);
+    job->at.stamp.year = utc.tm_year + 1900;
+    job->at.stamp.yday = utc.tm_yday + 1;
+    job->at.stamp.hour = utc.tm_hour;
+    job->at.stamp.min = utc.tm_min;
+    job->at.stamp.sec = utc.tm_sec;
+    job->at.start_ns = start_ns;
+    job->at.clock = CLOCK_REALTIME;
+    job->wake_ns = wake_ns;
+
+    if (pthread_create(&tid, NULL, send_frame, job) != 0) {
+        free(job);
+        return 1;
+    }
+    pthread_detach(tid);
+
+    return 0;
+}
+
+// Reads the channel's format from sysfs, ece331 if it can't
+static const struct wwv_proto *channel_proto(void)
+{
+    const char *name = strrchr(dev_path, '/') ? strrchr(dev_path, '/') + 1 : dev_path;
+    const struct wwv_proto *p = NULL;
+    char file[256];
+    char buf[32];
+    FILE *fp;
+
+    snprintf(file, sizeof(file), "/sys/class/wwv_class/%s/protocol", name);
+    fp = fopen(file, "r");
+    if (fp != NULL) {
+        if (fgets(buf, sizeof(buf), fp) != NULL) {
+            buf[strcspn(buf, "\n")] = 0;
+            p = wwv_proto_find(buf);
+        }
+        fclose(fp);
+    }
+    if (p == NULL) {
+        printf("Cannot read the format of %s, using ece331\n", name);
+        p = wwv_proto_find("ece331");
+    }
+
+    return p;
+}
+
+int main (int argc, char *argv[])
+{
+    int opt;
+    long lead_ms = 500;
+    long frames = 0;
+    long n = 0;
+    long long period;
+    long long boundary;
+    long long last = 0;
+    long long now;
+    int tfd;
+    int sfd;
+    int ret = 0;
+    sigset_t sigs;
+    struct itimerspec its;
+    struct pollfd pfd[2];
+    uint64_t ticks;
+
+    while ((opt = getopt(argc, argv, "l:s:n:h")) != -1) {
+        switch (opt) {
+            case 'l':
+                lead_ms = atol(optarg);
+                break;
+            case 's':
+                state_path = optarg;
+                break;
+            case 'n':
+                frames = atol(optarg);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (optind < argc) dev_path = argv[optind];
+    if (lead_ms < 1) {
+        usage();
+        return 1;
+    }
+
+    proto = channel_proto();
+    period = (long long)proto->period_us * 1000;
+    if (lead_ms * 1000000LL >= period) {
+        printf("Lead time must be under one %s frame\n", proto->name);
+        return 1;
+    }
+
+    fd = open(dev_path, O_WRONLY);
+    if (fd < 0) {
+        printf("Cannot open %s\n", dev_path);
+        return 1;
+    }
+
+    // Signals are taken from a signalfd so the sender threads, which
+    // inherit this mask, never see them
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+    sfd = signalfd(-1, &sigs, SFD_CLOEXEC);
+
+    // A step of the wall clock ends the wait early, so the wakeup is
+    // worked out again from the new time
+    tfd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    if (sfd < 0 || tfd < 0) {
+        perror("timerfd/signalfd failure\n");
+        close(fd);
+        return 1;
+    }
+    pfd[0].fd = tfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = sfd;
+    pfd[1].events = POLLIN;
+
+    pthread_mutex_lock(&lock);
+    write_state();
+    pthread_mutex_unlock(&lock);
+
+    while (frames == 0 || n < frames) {
+        // First boundary still at least the lead time off
+        now = now_ns();
+        boundary = ((now + lead_ms * 1000000LL) / period + 1) * period;
+
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = (boundary - lead_ms * 1000000LL) / NSEC;
+        its.it_value.tv_nsec = (boundary - lead_ms * 1000000LL) % NSEC;
+        if (timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL) < 0) {
+            perror("timerfd_settime() failure\n");
+            ret = 1;
+            break;
+        }
+
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll() failure\n");
+            ret = 1;
+            break;
+        }
+        if (pfd[1].revents & POLLIN) break;
+        if (read(tfd, &ticks, sizeof(ticks)) < 0) {
+            if (errno == ECANCELED || errno == EINTR) continue;
+            perror("read() failure\n");
+            ret = 1;
+            break;
+        }
+
+        pthread_mutex_lock(&lock);
+
+        // Boundaries passed over since the last frame, e.g. while the
+        // daemon was held up or the clock jumped ahead
+        if (last != 0 && boundary - last > period) m.missed += (boundary - last) / period - 1;
+        last = boundary;
+
+        if (inflight >= INFLIGHT_MAX || start_frame(boundary, boundary - lead_ms * 1000000LL)) {
+            m.missed++;
+            snprintf(m.last_error, sizeof(m.last_error), "%s", inflight ? "pin stuck" : "no thread");
+            write_state();
+        } else {
+            inflight++;
+        }
+        pthread_mutex_unlock(&lock);
+        n++;
+    }
+
+    // On a signal the frame on the pin stops at the end of its pulse
+    // instead of running out the minute. A frame still waiting for the
+    // pin gets it next, so keep cancelling until they are all back.
+    pthread_mutex_lock(&lock);
+    while (inflight > 0) {
+        if (frames == 0 || n < frames) {
+            ioctl(fd, WWV_CANCEL, WWV_CANCEL_PIN);
+            clock_gettime(CLOCK_REALTIME, &its.it_value);
+            its.it_value.tv_nsec += 100000000;
+            if (its.it_value.tv_nsec >= NSEC) {
+                its.it_value.tv_sec++;
+                its.it_value.tv_nsec -= NSEC;
+            }
+            pthread_cond_timedwait(&idle, &lock, &its.it_value);
+        } else {
+            pthread_cond_wait(&idle, &lock);
+        }
+    }
+    write_state();
+    pthread_mutex_unlock(&lock);
+
+    close(tfd);
+    close(sfd);
+    close(fd);
+    return ret;
+}
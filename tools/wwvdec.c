@@ -0,0 +1,137 @@
+/*
+ * Eric Sullivan
+ * Software stand-in for the ECE331 expansion board:
+ * decodes an edge trace file, or a sampled pin stream of one
+ * byte per sample, and prints each frame the way the board does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_rec.h"
+#include "wwv_dec.h"
+
+// Edges or samples read per chunk
+#define CHUNK 4096
+
+static int quiet;
+
+// Prints each decoded frame
+static void print_frame(void *ctx, const struct wwv_frame *f)
+{
+    char line[64];
+
+    if (quiet) return;
+    wwv_dec_format(f, line, sizeof(line));
+    puts(line);
+}
+
+// Feeds a trace file to the decoder
+static int decode_trace(struct wwv_dec *dec, FILE *fp)
+{
+    char magic[4];
+    u32 version;
+    struct wwv_edge edge[CHUNK];
+    size_t n;
+    size_t i;
+
+    if (fread(magic, 4, 1, fp) != 1 || memcmp(magic, WWV_TRACE_MAGIC, 4) ||
+        fread(&version, sizeof(version), 1, fp) != 1 || version != WWV_TRACE_VERSION) {
+        fprintf(stderr, "Not a trace file\n");
+        return 1;
+    }
+
+    while ((n = fread(edge, sizeof(struct wwv_edge), CHUNK, fp)) > 0) {
+        for (i = 0; i < n; i++) wwv_dec_edge(dec, edge[i].t, edge[i].level);
+    }
+
+    return ferror(fp);
+}
+
+// Feeds a sampled pin stream to the decoder, '0' or 0 is low
+static int decode_samples(struct wwv_dec *dec, FILE *fp, long rate)
+{
+    unsigned char buf[CHUNK];
+    u64 sample = 0;
+    size_t n;
+    size_t i;
+
+    while ((n = fread(buf, 1, CHUNK, fp)) > 0) {
+        for (i = 0; i < n; i++, sample++) {
+            wwv_dec_edge(dec, sample * 1000000000ULL / rate, buf[i] != 0 && buf[i] != '0');
+        }
+    }
+
+    return ferror(fp);
+}
+
+int main (int argc, char *argv[])
+{
+    int opt;
+    long rate = 0;
+    int decade = 2020;
+    long scale = 1;
+    int ret;
+    FILE *fp = stdin;
+    struct wwv_dec dec;
+    const struct wwv_proto *proto = wwv_proto_find("ece331");
+
+    while ((opt = getopt(argc, argv, "s:y:p:x:qh")) != -1) {
+        switch (opt) {
+            case 's':
+                rate = atol(optarg);
+                break;
+            case 'y':
+                decade = atoi(optarg);
+                break;
+            case 'p':
+                proto = wwv_proto_find(optarg);
+                if (proto == NULL) {
+                    printf("Unknown format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'x':
+                scale = atol(optarg);
+                if (scale < 1 || scale > WWV_SCALE_MAX) {
+                    printf("Scale must be 1 to %d\n", WWV_SCALE_MAX);
+                    return 1;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                printf("Usage: wwvdec [-s sample_rate] [-y decade] [-p ece331|wwv|wwvb|dcf77|irigb] [-x scale] [-q] [file]\n");
+                return 1;
+        }
+    }
+
+    if (optind < argc) {
+        fp = fopen(argv[optind], "rb");
+        if (fp == NULL) {
+            perror("fopen() failure\n");
+            return 1;
+        }
+    }
+
+    wwv_dec_init(&dec, print_frame, NULL);
+    wwv_dec_proto(&dec, proto);
+    dec.decade = decade;
+    dec.scale = scale;
+
+    if (rate > 0) {
+        ret = decode_samples(&dec, fp, rate);
+    } else {
+        ret = decode_trace(&dec, fp);
+    }
+    wwv_dec_finish(&dec);
+
+    fprintf(stderr, "%lu frames, %lu errors\n", dec.frames, dec.errors);
+    if (fp != stdin) fclose(fp);
+
+    return ret || dec.errors;
+}
@@ -0,0 +1,116 @@
+/*
+ * Eric Sullivan
+ * Checks an edge trace against a golden corpus:
+ * lines each frame of the trace up with the next golden frame and
+ * reports the first edge that is missing, extra, the wrong level or
+ * further off its golden time than the tolerance, with the slot and
+ * symbol it belongs to.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_rec.h"
+#include "wwv_gold.h"
+
+static const char *const sym_name[WWV_SYMS] = { "zero", "one", "marker", "blank" };
+
+static void usage(void)
+{
+    printf("Usage: wwvdiff [-t tolerance_us] [-x scale] [-q] golden [trace]\n");
+}
+
+// Prints an edge time in seconds, or that there was none
+static void print_edge(const char *what, long long ns, int level)
+{
+    if (ns < 0) {
+        printf("  %s: no edge\n", what);
+    } else {
+        printf("  %s: %s at %lld.%09lld s into the frame\n", what, level ? "high" : "low", ns / 1000000000, ns % 1000000000);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    int opt;
+    long tol_us = 0;
+    long scale = 1;
+    int quiet = 0;
+    int ret;
+    FILE *fp;
+    char iso[32];
+    struct wwv_gold g;
+    struct wwv_gold_diff res;
+    const struct wwv_gold_frame *fr;
+    struct wwv_trace tr;
+
+    while ((opt = getopt(argc, argv, "t:x:qh")) != -1) {
+        switch (opt) {
+            case 't':
+                tol_us = atol(optarg);
+                break;
+            case 'x':
+                scale = atol(optarg);
+                if (scale < 1 || scale > WWV_SCALE_MAX) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 2 || tol_us < 0) {
+        usage();
+        return 1;
+    }
+
+    fp = fopen(argv[optind], "r");
+    wwv_gold_init(&g);
+    if (fp == NULL || wwv_gold_read(&g, fp)) {
+        printf("Cannot read golden corpus %s\n", argv[optind]);
+        return 1;
+    }
+    fclose(fp);
+
+    fp = stdin;
+    if (argc - optind == 2) {
+        fp = fopen(argv[optind + 1], "rb");
+        if (fp == NULL) {
+            perror("fopen() failure\n");
+            return 1;
+        }
+    }
+    wwv_trace_init(&tr);
+    if (wwv_trace_read(&tr, fp)) {
+        printf("Not a trace file\n");
+        return 1;
+    }
+    if (fp != stdin) fclose(fp);
+
+    ret = wwv_gold_diff(&g, tr.edge, tr.len, (u64)tol_us * 1000, scale, &res);
+    if (ret && !quiet) {
+        if (res.frame >= (long)g.frames) {
+            printf("Trace goes on past the last of %zu %s frames\n", g.frames, g.proto->name);
+        } else {
+            fr = &g.frame[res.frame];
+            wwv_gold_format_stamp(&fr->stamp, iso, sizeof(iso));
+            printf("Frame %ld (%s 0x%02x) differs at slot %d (%s), edge %zu\n", res.frame + 1, iso,
+                fr->stamp.flags, res.slot, sym_name[(int)fr->sym[res.slot]], res.edge);
+        }
+        print_edge("golden", res.want_ns, res.want_level);
+        print_edge("trace", res.got_ns, res.got_level);
+    }
+    printf("%zu of %zu %s frames match\n", res.matched, g.frames, g.proto->name);
+
+    wwv_trace_free(&tr);
+    wwv_gold_free(&g);
+    return ret;
+}
@@ -0,0 +1,196 @@
+/*
+ * Eric Sullivan
+ * Records WWV frames to an edge trace file without the driver:
+ * encodes a run of consecutive frames (minutes, or seconds for
+ * IRIG-B), or the frames of a list, with the encoder core and writes
+ * the edges the pin would make as a trace or as a golden corpus.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_rec.h"
+#include "wwv_gold.h"
+
+static void usage(void)
+{
+    printf("Usage: wwvrec [-n frames] [-o file] [-p ece331|wwv|wwvb|dcf77|irigb] [-x scale] [-g] year doy hour minute\n");
+    printf("       wwvrec [-i list] [-o file] [-p ece331|wwv|wwvb|dcf77|irigb] [-x scale] [-g]\n");
+}
+
+/*
+ * Reads a stamp from a line of a frame list: an ISO 8601 UTC time,
+ * then WWV_STAMP_* flags if any. Returns 0 for a stamp, -1 for a
+ * blank or # comment line and 1 for a bad line.
+ */
+static int read_stamp(char *line, struct wwv_stamp *stamp)
+{
+    char *iso = strtok(line, " \t\r\n");
+    char *flags = strtok(NULL, " \t\r\n");
+
+    if (iso == NULL || iso[0] == '#') return -1;
+    if (wwv_parse_iso(iso, strlen(iso), stamp)) return 1;
+    if (flags != NULL) stamp->flags = strtoul(flags, NULL, 0);
+
+    return 0;
+}
+
+/*
+ * Encodes and records one frame. In golden mode the frame is written
+ * straight out as a corpus entry, otherwise it goes on the end of
+ * the trace. Returns 0 on success, 1 otherwise.
+ */
+static int rec_frame(FILE *fp, struct wwv_trace *tr, const struct wwv_proto *proto,
+                     const struct wwv_stamp *stamp, int golden)
+{
+    struct wwv_date dtime;
+    struct wwv_sched sched;
+    char iso[32];
+
+    if (wwv_conv_stamp(stamp, &dtime) || wwv_enc_frame(&sched, proto, &dtime)) {
+        wwv_gold_format_stamp(stamp, iso, sizeof(iso));
+        printf("Frame %s did not encode!\n", iso);
+        return 1;
+    }
+
+    if (golden) wwv_trace_reset(tr);
+    if (wwv_rec_frame(tr, &sched)) {
+        printf("Out of memory!\n");
+        return 1;
+    }
+    if (golden && wwv_gold_write_frame(fp, proto, stamp, tr->edge, tr->len)) {
+        perror("write failure\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    int opt;
+    long frames = 1;
+    long scale = 1;
+    long i;
+    char *out = NULL;
+    char *list = NULL;
+    int golden = 0;
+    int ret = 0;
+    FILE *fp = stdout;
+    FILE *lp = NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    struct tm start;
+    struct tm utc;
+    time_t t;
+    struct wwv_stamp stamp;
+    struct wwv_trace tr;
+    const struct wwv_proto *proto = wwv_proto_find("ece331");
+
+    while ((opt = getopt(argc, argv, "n:o:p:x:i:gh")) != -1) {
+        switch (opt) {
+            case 'n':
+                frames = atol(optarg);
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            case 'p':
+                proto = wwv_proto_find(optarg);
+                if (proto == NULL) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'x':
+                scale = atol(optarg);
+                if (scale < 1 || scale > WWV_SCALE_MAX) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'i':
+                list = optarg;
+                break;
+            case 'g':
+                golden = 1;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ((list == NULL && argc - optind != 4) || (list != NULL && argc != optind) ||
+        frames < 1 || (golden && scale != 1)) {
+        usage();
+        return 1;
+    }
+
+    if (list != NULL) {
+        lp = strcmp(list, "-") ? fopen(list, "r") : stdin;
+        if (lp == NULL) {
+            perror("fopen() failure\n");
+            return 1;
+        }
+    }
+    if (out != NULL) {
+        fp = fopen(out, "wb");
+        if (fp == NULL) {
+            perror("fopen() failure\n");
+            return 1;
+        }
+    }
+
+    wwv_trace_init(&tr);
+    tr.scale = scale;
+    if (golden) wwv_gold_header(fp, proto);
+
+    if (lp != NULL) {
+        // Frames from the list, in its order
+        while (ret == 0 && getline(&line, &cap, lp) > 0) {
+            memset(&stamp, 0, sizeof(stamp));
+            opt = read_stamp(line, &stamp);
+            if (opt > 0) {
+                printf("Bad line in %s\n", list);
+                ret = 1;
+            } else if (opt == 0) {
+                ret = rec_frame(fp, &tr, proto, &stamp, golden);
+            }
+        }
+        free(line);
+        if (lp != stdin) fclose(lp);
+    } else {
+        // Day of year is counted from 1, like the driver expects
+        memset(&start, 0, sizeof(start));
+        start.tm_year = atoi(argv[optind]) - 1900;
+        start.tm_mday = atoi(argv[optind + 1]);
+        start.tm_hour = atoi(argv[optind + 2]);
+        start.tm_min = atoi(argv[optind + 3]);
+        t = timegm(&start);
+
+        // Consecutive frames
+        for (i = 0; ret == 0 && i < frames; i++, t += proto->period_us / 1000000) {
+            gmtime_r(&t, &utc);
+            memset(&stamp, 0, sizeof(stamp));
+            stamp.year = utc.tm_year + 1900;
+            stamp.yday = utc.tm_yday + 1;
+            stamp.hour = utc.tm_hour;
+            stamp.min = utc.tm_min;
+            stamp.sec = utc.tm_sec;
+            ret = rec_frame(fp, &tr, proto, &stamp, golden);
+        }
+    }
+
+    if (ret == 0 && !golden && wwv_trace_write(&tr, fp)) {
+        perror("write failure\n");
+        ret = 1;
+    }
+    if (fp != stdout) fclose(fp);
+
+    wwv_trace_free(&tr);
+    return ret;
+}
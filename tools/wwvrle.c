@@ -0,0 +1,168 @@
+/*
+ * Eric Sullivan
+ * Sends a run-length waveform to the wwv driver with WWV_TRANSMIT_RLE:
+ * reads a text file of runs, one "low|high|carrier usecs" per line,
+ * checks it the way the driver will and plays it on the pin. With -e
+ * it prints the runs of an encoded frame instead, as a starting point
+ * for a waveform the encoders don't make, e.g. a malformed frame for
+ * testing a receiver.
+ * Usage: wwvrle [-c] [-d device] [file]
+ *        wwvrle [-p ece331|wwv|wwvb|dcf77|irigb] -e time
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include "wwv.h"
+#include "wwv_enc.h"
+
+static const char *const level_name[] = {
+    [WWV_RLE_LOW] = "low",
+    [WWV_RLE_HIGH] = "high",
+    [WWV_RLE_CARRIER] = "carrier",
+};
+
+static void usage(void)
+{
+    printf("Usage: wwvrle [-c] [-d device] [file]\n");
+    printf("       wwvrle [-p ece331|wwv|wwvb|dcf77|irigb] -e time\n");
+}
+
+/*
+ * Reads runs from a text file into a waveform. Blank lines and lines
+ * starting with # are skipped. Returns 0 on success, the line number
+ * of the first bad line otherwise.
+ */
+static int read_rle(FILE *fp, struct wwv_rle *rle)
+{
+    char line[128];
+    char *name;
+    char *usecs;
+    char *end;
+    int n = 0;
+    int l;
+
+    memset(rle, 0, sizeof(*rle));
+    rle->version = WWV_RLE_VERSION;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        n++;
+        name = strtok(line, " \t\r\n");
+        if (name == NULL || name[0] == '#') continue;
+        usecs = strtok(NULL, " \t\r\n");
+        if (usecs == NULL || rle->count >= WWV_RLE_MAX) return n;
+
+        for (l = WWV_RLE_LOW; l <= WWV_RLE_CARRIER && strcmp(name, level_name[l]); l++);
+        if (l > WWV_RLE_CARRIER) return n;
+
+        rle->run[rle->count].level = l;
+        rle->run[rle->count].usecs = strtoul(usecs, &end, 10);
+        if (*end != 0) return n;
+        rle->count++;
+    }
+
+    return 0;
+}
+
+/*
+ * Prints the runs of one encoded frame in the format read_rle() takes.
+ */
+static int print_frame(const struct wwv_proto *proto, const char *iso)
+{
+    struct wwv_stamp stamp;
+    struct wwv_date dtime;
+    struct wwv_sched sched;
+    int i;
+
+    if (wwv_parse_iso(iso, strlen(iso), &stamp) || wwv_conv_stamp(&stamp, &dtime) ||
+        wwv_enc_frame(&sched, proto, &dtime)) {
+        printf("Frame %s did not encode!\n", iso);
+        return 1;
+    }
+
+    printf("# %s %s\n", proto->name, iso);
+    for (i = 0; i < sched.len; i++) printf("%s %u\n", level_name[sched.run[i].level], sched.run[i].usecs);
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    int opt;
+    int check = 0;
+    int fd;
+    int ret;
+    const char *dev_path = "/dev/wwv0";
+    const char *iso = NULL;
+    const struct wwv_proto *proto = wwv_proto_find("ece331");
+    FILE *fp = stdin;
+    struct wwv_rle rle;
+    struct wwv_sched sched;
+
+    while ((opt = getopt(argc, argv, "cd:p:e:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                check = 1;
+                break;
+            case 'd':
+                dev_path = optarg;
+                break;
+            case 'p':
+                proto = wwv_proto_find(optarg);
+                if (proto == NULL) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'e':
+                iso = optarg;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (argc - optind > 1 || (iso != NULL && argc - optind > 0)) {
+        usage();
+        return 1;
+    }
+
+    if (iso != NULL) return print_frame(proto, iso);
+
+    if (argc - optind == 1) {
+        fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            perror("fopen() failure\n");
+            return 1;
+        }
+    }
+    ret = read_rle(fp, &rle);
+    if (fp != stdin) fclose(fp);
+    if (ret) {
+        printf("Bad run on line %d\n", ret);
+        return 1;
+    }
+
+    // Same checks as the driver, so a bad waveform is caught here
+    if (wwv_rle_load(&sched, &rle)) {
+        printf("Waveform is not valid: runs must be %d-%d long, at least %d us each, and carrier runs whole %d us cycles\n",
+               1, WWV_RLE_MAX, WWV_RLE_MIN_US, WWV_CYCLE);
+        return 1;
+    }
+    printf("%u runs, %llu us\n", rle.count, (unsigned long long)wwv_sched_ns(&sched) / 1000);
+    if (check) return 0;
+
+    fd = open(dev_path, O_WRONLY);
+    if (fd < 0) {
+        printf("Cannot open %s\n", dev_path);
+        return 1;
+    }
+    ret = ioctl(fd, WWV_TRANSMIT_RLE, &rle);
+    if (ret < 0) perror("ioctl() failure\n");
+    close(fd);
+
+    return ret < 0;
+}
@@ -17,4 +17,200 @@
 // IOCTL Write to pass in date/time data
 #define WWV_TRANSMIT _IOW(WWV_MAGIC,1,struct tm *)
 
+// IOCTL Write to queue date/time data without waiting for it to be sent
+#define WWV_SUBMIT _IOW(WWV_MAGIC,2,struct tm *)
+
+// IOCTL Read of the transmit queue state, also clears the poll() event
+#define WWV_STATUS _IOR(WWV_MAGIC,3,struct wwv_status)
+
+// IOCTL to turn free running broadcast mode on (arg 1) or off (arg 0).
+// Like WWV_SET_PROTO, WWV_SET_SCALE and WWV_CANCEL it takes the value
+// in arg itself, not through a pointer.
+#define WWV_BROADCAST _IO(WWV_MAGIC,4)
+
+// Version of struct wwv_batch described here
+#define WWV_BATCH_VERSION 1
+
+// Most timestamps one WWV_TRANSMIT_BATCH can carry
+#define WWV_BATCH_MAX 64
+
+// IOCTL Write to queue a batch of timestamps to be sent back to back
+#define WWV_TRANSMIT_BATCH _IOW(WWV_MAGIC,5,struct wwv_batch)
+
+// IOCTL telling the driver frames were put on an empty mmap() ring
+#define WWV_RING_KICK _IO(WWV_MAGIC,6)
+
+// IOCTL Read of the pin admission counters
+#define WWV_ADMIT_STATS _IOR(WWV_MAGIC,7,struct wwv_admit_stats)
+
+// Timecode formats a channel can send
+#define WWV_PROTO_ECE331 0	// WWV as the ECE331 expansion board decodes it
+#define WWV_PROTO_WWV 1		// NIST WWV/WWVH, all fields
+#define WWV_PROTO_WWVB 2	// NIST WWVB amplitude code
+#define WWV_PROTO_DCF77 3	// DCF77 amplitude code
+#define WWV_PROTO_IRIGB 4	// IRIG-B004 DC level shift, a frame every second
+
+// IOCTL to pick the channel's timecode format (arg WWV_PROTO_*)
+#define WWV_SET_PROTO _IO(WWV_MAGIC,8)
+
+// IOCTL to send frames faster than real time for testing (arg 1 to
+// WWV_SCALE_MAX, 1 for real time). Every pulse, gap and subcarrier
+// cycle is divided by it. Refused in broadcast mode.
+#define WWV_SET_SCALE _IO(WWV_MAGIC,9)
+#define WWV_SCALE_MAX 1000
+
+// IOCTL to send one frame with its first edge at an absolute time
+// (struct wwv_at). Blocks until the frame is sent, like WWV_TRANSMIT,
+// and fails with ETIME if the time has passed once the pin is free.
+// A start up to 20 ms past still goes out at once, so a frame can
+// follow one that ran right up to its start.
+#define WWV_TRANSMIT_AT _IOWR(WWV_MAGIC,10,struct wwv_at)
+
+// IOCTL to stop frames early (arg is WWV_CANCEL_* bits). A frame on
+// the pin stops at once if the pin is low between pulses, or at the
+// end of the pulse it's in, and leaves the pin low. A
+// WWV_TRANSMIT or WWV_TRANSMIT_AT caller sending it gets ECANCELED.
+// A signal does the same to the caller's own frame, which then fails
+// with EINTR. Queued frames that are dropped count as completed.
+#define WWV_CANCEL _IO(WWV_MAGIC,11)
+#define WWV_CANCEL_PIN 0x01	// The frame on the pin now
+#define WWV_CANCEL_QUEUE 0x02	// Every frame on the transmit queue
+
+// IOCTL to queue a frame ahead of every frame waiting (struct
+// wwv_urgent). Fails with EAGAIN rather than wait if the queue is full.
+#define WWV_SUBMIT_URGENT _IOW(WWV_MAGIC,12,struct wwv_urgent)
+#define WWV_URGENT_PREEMPT 0x01	// Also stop a queued frame on the pin
+
+// IOCTL to play a waveform built in userspace (struct wwv_rle) on the
+// pin, for formats and malformed frames the driver has no encoder
+// for. Takes its turn for the pin, blocks and stops early like
+// WWV_TRANSMIT, and fails with EINVAL if any run is out of range.
+#define WWV_TRANSMIT_RLE _IOW(WWV_MAGIC,13,struct wwv_rle)
+
+// Version of struct wwv_rle described here
+#define WWV_RLE_VERSION 1
+
+// Most runs one waveform can carry
+#define WWV_RLE_MAX 208
+
+// Shortest run in usecs, so the engine's timer keeps up
+#define WWV_RLE_MIN_US 100
+
+// Levels a run can hold the pin at
+#define WWV_RLE_LOW 0		// Pin held low
+#define WWV_RLE_HIGH 1		// Pin held high
+#define WWV_RLE_CARRIER 2	// 100 Hz subcarrier, whole 10 ms cycles only
+
+// wwv_stamp flags, for the fields only the full formats carry
+#define WWV_STAMP_DST1 0x01	// DST in effect at 24:00 UTC today
+#define WWV_STAMP_DST2 0x02	// DST in effect at 00:00 UTC today
+#define WWV_STAMP_LSW 0x04	// Leap second at the end of the month
+#define WWV_STAMP_DUT1_NEG 0x08	// UT1 - UTC is below zero
+#define WWV_STAMP_DUT1(tenths) ((tenths) << 4)	// Size of UT1 - UTC, 0-9 tenths
+#define WWV_STAMP_DUT1_TENTHS(flags) (((flags) >> 4) & 0xf)
+
+// write() to /dev/wwvN queues frames from a stream of either binary
+// struct wwv_stamp records or lines of ISO 8601 UTC text, e.g.
+// "2020-04-17T12:34Z" or "2020-108T12:34:56Z". Blank lines and lines
+// starting with # are skipped. Records are in the host's byte order.
+// The first two bytes written to a file pick the format: read as a
+// record's __s16 year, a stream of records starts with a year from
+// WWV_STREAM_YEAR_MIN to WWV_STREAM_YEAR_MAX (0x0700-0x08ff, so one
+// of its bytes is 0x07 or 0x08 on either endianness), and text, with
+// no byte below a tab, never does. Each record is queued like
+// WWV_SUBMIT, and a partial write() stops at the first one that
+// doesn't fit, or isn't valid, with the bytes before it taken. A
+// write() that starts with one that isn't valid fails with EINVAL and
+// drops it, so the next write() carries on after it. A line longer
+// than WWV_LINE_MAX fails the same way, and what is written after it
+// is dropped up to the line's newline.
+#define WWV_LINE_MAX 64		// Longest text line, newline included
+#define WWV_STREAM_YEAR_MIN 1792	// Range of years a record stream can start with
+#define WWV_STREAM_YEAR_MAX 2303
+
+// Slots in the mmap() ring (power of 2)
+#define WWV_RING_SLOTS 256
+
+// Transmit queue state returned by WWV_STATUS
+struct wwv_status {
+    __u32 queued;		// Frames waiting in the queue
+    __u32 active;		// 1 while a queued frame is on the pin
+    __u64 submitted;		// Frames queued since the driver loaded
+    __u64 completed;		// Queued frames that have been sent
+};
+
+// Pin admission counters returned by WWV_ADMIT_STATS. Callers of
+// WWV_TRANSMIT and the channel's queue worker take turns on the pin
+// in the order they asked for it.
+struct wwv_admit_stats {
+    __u32 depth;		// Callers waiting for the pin right now
+    __u32 busy;			// 1 while someone has the pin
+    __u64 admitted;		// Times the pin was handed out
+    __u64 rejected;		// O_NONBLOCK callers turned away with EAGAIN
+    __u64 timedout;		// Waiters that gave up with ETIMEDOUT
+    __u64 interrupted;		// Waiters woken by a signal
+    __u64 wait_ns;		// Total time admitted callers waited
+    __u64 wait_max_ns;		// Longest time one admitted caller waited
+};
+
+// Fixed size UTC timestamp
+struct wwv_stamp {
+    __s16 year;			// Full year, e.g. 2020
+    __u16 yday;			// Day of year, counted from 1
+    __u8 hour;			// 0-23
+    __u8 min;			// 0-59
+    __u8 sec;			// 0-60, not sent in WWV frames
+    __u8 flags;			// WWV_STAMP_* bits, 0 if unused
+};
+
+// Frame and start time passed to WWV_TRANSMIT_AT
+struct wwv_at {
+    struct wwv_stamp stamp;	// Frame to send
+    __s64 start_ns;		// Start of the frame in ns since the clock's epoch
+    __u32 clock;		// CLOCK_REALTIME or CLOCK_TAI
+    __u32 pad;			// 0
+    __s64 late_ns;		// Returned: how late the first edge really was
+};
+
+// Frame passed to WWV_SUBMIT_URGENT
+struct wwv_urgent {
+    struct wwv_stamp stamp;	// Frame to send
+    __u32 flags;		// WWV_URGENT_* bits
+    __u32 pad;			// 0
+};
+
+// One run of a waveform, the pin stays at level for usecs
+struct wwv_rle_run {
+    __u32 usecs;		// Length, at least WWV_RLE_MIN_US
+    __u32 level;		// WWV_RLE_* value
+};
+
+// Waveform passed to WWV_TRANSMIT_RLE. It starts at once and the pin
+// is left low after the last run.
+struct wwv_rle {
+    __u32 version;		// WWV_RLE_VERSION
+    __u32 count;		// Runs used in run[], 1-WWV_RLE_MAX
+    struct wwv_rle_run run[WWV_RLE_MAX];
+};
+
+// Batch of timestamps passed to WWV_TRANSMIT_BATCH
+struct wwv_batch {
+    __u32 version;		// WWV_BATCH_VERSION
+    __u32 count;		// Timestamps used in stamps[], 1-WWV_BATCH_MAX
+    struct wwv_stamp stamps[WWV_BATCH_MAX];
+};
+
+// Frame ring shared with the driver by mmap() of /dev/wwvN. The producer
+// fills stamp[head % WWV_RING_SLOTS] then bumps head. The driver sends
+// the frame at tail and bumps tail. If head == tail before the producer
+// bumps head, the ring was empty and it must follow up with
+// WWV_RING_KICK. The device must be opened O_RDWR to map it.
+struct wwv_ring {
+    __u32 head;			// Next slot to fill, written by the producer
+    __u32 tail;			// Next slot to send, written by the driver
+    __u32 slots;		// WWV_RING_SLOTS
+    __u32 dropped;		// Invalid stamps the driver skipped
+    struct wwv_stamp stamp[WWV_RING_SLOTS];
+};
+
 #endif	// WWV_H
@@ -0,0 +1,2720 @@
+// A. Sheaff 3/15/2019 - wwv driver
+// Framework code for creating a kernel driver
+// that creates the digital data from WWV station
+// Pass in time/date data through ioctl.
+
+/*
+ * Framework modified by Eric Sullivan
+ * 03/21/2020
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/spinlock.h>
+#include <linux/delay.h>
+#include <linux/list.h>
+#include <linux/io.h>
+#include <linux/ioctl.h>
+#include <linux/uaccess.h>
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/slab.h>
+#include <linux/gpio.h>
+#include <linux/of_gpio.h>
+#include <linux/of_address.h>
+#include <linux/platform_device.h>
+#include <linux/pinctrl/consumer.h>
+#include <linux/gpio/consumer.h>
+#include <linux/gpio/driver.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/time.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/poll.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/cpu.h>
+#include <linux/smp.h>
+#include <linux/bitops.h>
+#include <linux/cdev.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/sched/signal.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+
+#include "wwv.h"
+#include "wwv_enc.h"
+#include "wwv_pin.h"
+#include "wwv_pdata.h"
+
+#define CREATE_TRACE_POINTS
+#include "wwv_trace.h"
+
+// ADD ANY WWV DEFINE BELOW THIS LINE
+
+// Minor numbers reserved for /dev/wwvN over all instances
+#define WWV_MINORS 16
+
+// Transmit channels per DT instance, one for each output pin
+#define WWV_CHANS 4
+
+// Frames the transmit queue can hold (power of 2). A whole
+// WWV_TRANSMIT_BATCH has to fit.
+#define WWV_QUEUE_LEN 128
+
+// Buckets in a timing histogram, the last one holds 2^22 usecs and up
+#define WWV_HIST_BUCKETS 24
+
+// Pulse width histograms, one per bit envelope (WWV_SYM_ZERO, ONE
+// and MARKER)
+#define WWV_PULSE_KINDS 3
+
+// Default bound in ms on how long WWV_TRANSMIT waits for the pin, a
+// few frames' worth
+#define WWV_ADMIT_TIMEOUT_MS (5 * 60 * MSEC_PER_SEC)
+
+// wwv_admit_enter() flags
+#define WWV_ADMIT_NONBLOCK 1	// Fail with -EAGAIN instead of waiting
+#define WWV_ADMIT_KERNEL 2	// Driver's own worker, waits for good
+
+// How late the worker can be picking up the next queued frame and
+// still start it right where the last one ended
+#define WWV_CHAIN_SLACK_NS (20 * NSEC_PER_MSEC)
+
+// Timing error histogram, in power of two usec buckets
+struct wwv_hist {
+    u64 early[WWV_HIST_BUCKETS];	// Errors below zero
+    u64 late[WWV_HIST_BUCKETS];	// Errors of zero and above
+    u64 count;			// Samples taken
+    s64 sum;			// Sum of the errors in ns
+    s64 min;			// Smallest error in ns
+    s64 max;			// Largest error in ns
+};
+
+// Per CPU timing stats kept by the engine
+struct wwv_stats {
+    struct wwv_hist late;	// Edge time against its scheduled time
+    struct wwv_hist width[WWV_PULSE_KINDS];	// Pulse envelope length error
+    struct wwv_hist frame;	// Whole frame length error
+    struct wwv_hist slip;	// Frame end against the start of the next period
+    struct u64_stats_sync syncp;	// Lets debugfs read the u64s whole on 32-bit
+};
+
+// Timing engine state for playing a schedule out on a pin
+struct wwv_engine {
+    struct hrtimer timer;	// Fires at each edge
+    struct gpio_desc *pin;	// Pin being driven
+    struct wwv_mmio_pin mmio;	// Register fast path for the pin
+    int use_mmio;		// Set to drive the pin through mmio
+    int pin_sleeps;		// Set if the pin's chip may sleep, so pin_work sets it
+    int pin_level;		// Level pin_work sets the pin to
+    struct work_struct pin_work;	// Sets a sleeping pin outside the timer
+    struct wwv_cursor cur;	// Position in the schedule being played
+    ktime_t start;		// Absolute time the schedule started
+    ktime_t next;		// Absolute time of the next edge
+    ktime_t end;		// Schedule is cut off here, 0 for no limit
+    int done;			// Set once the schedule has finished
+    int abort;			// Set to stop once no pulse is on the pin
+    int cut;			// Set if the schedule was stopped early
+    int halted;			// Set while Shutdown is asserted, nothing starts
+    spinlock_t lock;		// Orders arming and aborts against a halt
+    wait_queue_head_t wait;	// Sender sleeps here until done
+    struct wwv_stats __percpu *stats;	// Timing stats, one copy per CPU
+    ktime_t actual_start;	// When the first edge really happened
+    ktime_t pulse_start;	// When the open pulse really started
+    s64 pulse_ns;		// Scheduled length of the open pulse
+    int pulse_class;		// WWV_SYM_* of the open pulse, -1 if none
+    u32 scale;			// Time compression for the next frame, 1 for real time
+    struct wwv_edge *log;	// Edge log for debugfs, NULL if off
+    u32 log_len;		// Entries in log (power of 2)
+    u32 log_head;		// Next entry to fill, written by the timer
+    u32 log_tail;		// Next entry to read, written by the reader
+    u32 log_dropped;		// Edges lost to a full log
+    int log_level;		// Level of the last logged edge
+    struct mutex log_read;	// One reader of the log at a time
+    int minor;			// Channel, for tracepoints
+};
+
+// Caller waiting its turn for the pin
+struct wwv_waiter {
+    struct list_head list;	// Place in the admission queue
+    struct task_struct *task;	// Task to wake
+    int granted;		// Set once the pin was handed over
+};
+
+// FIFO admission to a channel's pin. Whoever holds it owns the engine
+// and the schedule cache.
+struct wwv_admit {
+    spinlock_t lock;		// Protects everything below
+    struct list_head waiters;	// Oldest first
+    int busy;			// Set while someone holds the pin
+    unsigned int depth;		// Entries on waiters
+    unsigned int timeout_ms;	// Bound on a WWV_TRANSMIT wait, 0 for none
+    u64 admitted;		// Times the pin was handed out
+    u64 rejected;		// O_NONBLOCK callers turned away
+    u64 timedout;		// Waiters that ran out of time
+    u64 interrupted;		// Waiters hit by a signal
+    u64 wait_ns;		// Total wait of admitted callers
+    u64 wait_max_ns;		// Longest wait of an admitted caller
+    int minor;			// Channel, for tracepoints
+};
+
+// Data to be "passed" around to various functions, one per channel
+struct wwv_data_t {
+    struct gpio_desc *gpio_wwv;		// Pin this channel drives
+    int minor;			// Minor number, N in /dev/wwvN
+    struct cdev *cdev;		// Character device, lives until its last file closes
+    struct kref ref;		// Held by the instance and by each open file
+    struct device *wwv_dev;	// Device for auto /dev population
+    // ADD YOUR LOCKING VARIABLE BELOW THIS LINE
+    struct wwv_admit admit;	// Turns on the pin
+    struct wwv_sched sched;	// Last compiled frame
+    struct wwv_date sched_date;	// Date the schedule was compiled for
+    int sched_valid;		// Set when sched matches sched_date
+    const struct wwv_proto *proto;	// Timecode format frames go out in
+    struct wwv_engine eng;	// Timing engine for the WWV pin
+    spinlock_t qlock;		// Protects the queue and counters below
+    struct wwv_date queue[WWV_QUEUE_LEN];	// Frames waiting to be sent
+    unsigned int q_head;	// Next slot to fill
+    unsigned int q_tail;	// Next slot to send
+    int active;			// Set while the worker is sending a frame
+    int on_pin;			// Set while the worker's frame is on the engine
+    int stopping;		// Set once the channel is going away, files on it get -ENODEV
+    u64 submitted;		// Frames queued since probe
+    u64 completed;		// Frames sent since probe
+    struct workqueue_struct *wq;	// Worker that drains the queue
+    struct work_struct work;	// Work item for the worker
+    wait_queue_head_t pollq;	// poll() and full queue waiters
+    int broadcast;		// Set while in free running broadcast mode
+    struct work_struct bcast_work;	// Work item for broadcast mode
+    struct wwv_ring *ring;	// Page shared with userspace by mmap()
+    u32 ring_tail;		// Next ring slot to send
+    struct dentry *debugfs;	// debugfs directory for the timing stats
+};
+
+// One DT instance of the driver and the channels on its pins
+struct wwv_inst {
+    struct gpio_desc *gpio_shutdown;	// Shutdown input
+    int shutdown_irq;		// IRQ on both edges of Shutdown, 0 if none
+    int shutdown;		// Last level read from Shutdown
+    struct mutex shutdown_lock;	// One reader of Shutdown at a time
+    int nchan;			// Channels in use
+    struct wwv_data_t *chan[WWV_CHANS];	// Channel for each output pin
+};
+
+// Format of the stream written to a file, picked by its first bytes
+#define WWV_WMODE_NONE 0	// Not known yet
+#define WWV_WMODE_BINARY 1	// struct wwv_stamp records
+#define WWV_WMODE_TEXT 2	// ISO 8601 lines
+
+// Per open file data
+struct wwv_file {
+    struct wwv_data_t *wwv_dat;	// Device this file was opened on
+    u64 seen;			// Completions already reported to poll()
+    struct mutex wlock;		// One write() at a time, protects the rest
+    int wmode;			// WWV_WMODE_* of the stream
+    int wlen;			// Bytes held in wbuf
+    int wskip;			// Set while dropping the rest of a line that was too long
+    char wbuf[WWV_LINE_MAX];	// Start of a record or line not yet complete
+};
+
+// Output pins in the DT node, each one gets its own channel
+static const char * const wwv_chan_pins[WWV_CHANS] = {
+    "WWV", "Unused17", "Unused18", "Unused22",
+};
+
+// Shared by every instance
+static dev_t wwv_devt;		// First of the WWV_MINORS device numbers
+static struct class *wwv_class;	// Class for auto /dev population
+static struct dentry *wwv_debugfs;	// debugfs directory holding the channels
+static DEFINE_IDR(wwv_idr);	// Channel on each minor in use
+static DEFINE_MUTEX(wwv_idr_lock);	// Protects wwv_idr, so open() can't race a destroy
+
+// How the engines set their pins: "auto" writes the GPIO registers
+// when the DT node has a reg for them, "gpiod" always goes through
+// gpiolib and "mmio" fails the probe without the registers
+static char *pin_backend = "auto";
+module_param(pin_backend, charp, 0444);
+MODULE_PARM_DESC(pin_backend, "Pin backend: auto, gpiod or mmio");
+
+// Edges each channel keeps for debugfs wwvN/edges, 0 to keep none.
+// Rounded up to a power of 2.
+static unsigned int edge_log;
+module_param(edge_log, uint, 0444);
+MODULE_PARM_DESC(edge_log, "Edges logged per channel for debugfs, 0 for none");
+
+// ADD YOUR WWV ENCODING/TRANSMITING/MANAGEMENT FUNCTIONS BELOW THIS LINE
+
+/*
+ * Sets up an idle admission queue.
+ */
+static void wwv_admit_init(struct wwv_admit *adm)
+{
+    memset(adm, 0, sizeof(*adm));
+    spin_lock_init(&adm->lock);
+    INIT_LIST_HEAD(&adm->waiters);
+    adm->timeout_ms = WWV_ADMIT_TIMEOUT_MS;
+}
+
+/*
+ * Takes the pin. A free pin is taken right away, otherwise the caller
+ * joins the back of the queue and sleeps until the pin is handed to
+ * it. With WWV_ADMIT_NONBLOCK a busy pin returns -EAGAIN, so the check
+ * and the take can't be split by another caller. Userspace waits end
+ * early with -ERESTARTSYS on a signal or -ETIMEDOUT after timeout_ms.
+ */
+static int wwv_admit_enter(struct wwv_admit *adm, int flags)
+{
+    struct wwv_waiter w;
+    ktime_t start = ktime_get();
+    long left = MAX_SCHEDULE_TIMEOUT;
+    // The worker's wait has no time limit, so it sleeps idle rather
+    // than trip the hung task check or count in the load average
+    int state = (flags & WWV_ADMIT_KERNEL) ? TASK_IDLE : TASK_INTERRUPTIBLE;
+    u64 waited;
+    int ret = 0;
+
+    spin_lock(&adm->lock);
+
+    // The pin is passed straight to the next waiter, so a free pin
+    // means nobody is queued
+    if (!adm->busy) {
+        adm->busy = 1;
+        adm->admitted++;
+        spin_unlock(&adm->lock);
+        trace_wwv_admit(adm->minor, 0, 0);
+        return 0;
+    }
+
+    if (flags & WWV_ADMIT_NONBLOCK) {
+        adm->rejected++;
+        spin_unlock(&adm->lock);
+        trace_wwv_admit(adm->minor, 0, -EAGAIN);
+        return -EAGAIN;
+    }
+
+    if (!(flags & WWV_ADMIT_KERNEL) && adm->timeout_ms)
+        left = msecs_to_jiffies(adm->timeout_ms);
+
+    w.task = current;
+    w.granted = 0;
+    list_add_tail(&w.list, &adm->waiters);
+    adm->depth++;
+
+    // granted only changes under the lock, so it's checked with it held
+    for (;;) {
+        set_current_state(state);
+        if (w.granted) break;
+        if (state == TASK_INTERRUPTIBLE && signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        if (left == 0) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        spin_unlock(&adm->lock);
+        left = schedule_timeout(left);
+        spin_lock(&adm->lock);
+    }
+    __set_current_state(TASK_RUNNING);
+
+    if (ret) {
+        // Never got the pin, leave the queue
+        list_del(&w.list);
+        adm->depth--;
+        if (ret == -ETIMEDOUT) {
+            adm->timedout++;
+        } else {
+            adm->interrupted++;
+        }
+    } else {
+        waited = ktime_to_ns(ktime_sub(ktime_get(), start));
+        adm->admitted++;
+        adm->wait_ns += waited;
+        if (waited > adm->wait_max_ns) adm->wait_max_ns = waited;
+    }
+    spin_unlock(&adm->lock);
+
+    if (trace_wwv_admit_enabled())
+        trace_wwv_admit(adm->minor, ktime_to_ns(ktime_sub(ktime_get(), start)), ret);
+
+    return ret;
+}
+
+/*
+ * Gives up the pin, handing it to the oldest waiter if there is one.
+ */
+static void wwv_admit_exit(struct wwv_admit *adm)
+{
+    struct wwv_waiter *w;
+
+    spin_lock(&adm->lock);
+    if (list_empty(&adm->waiters)) {
+        adm->busy = 0;
+    } else {
+        w = list_first_entry(&adm->waiters, struct wwv_waiter, list);
+        list_del(&w->list);
+        adm->depth--;
+        w->granted = 1;
+        // Woken under the lock, w is on the waiter's stack and is gone
+        // as soon as it sees granted
+        wake_up_process(w->task);
+    }
+    spin_unlock(&adm->lock);
+}
+
+/*
+ * Returns the schedule for a date in the channel's current format,
+ * only compiling it if it differs from the last frame that was sent.
+ * Must be called holding the pin.
+ */
+static struct wwv_sched *wwv_get_sched(struct wwv_data_t *wwv_dat, struct wwv_date *dtime)
+{
+    const struct wwv_proto *proto = READ_ONCE(wwv_dat->proto);
+
+    if (wwv_dat->sched_valid && wwv_dat->sched.proto == proto &&
+        !memcmp(&wwv_dat->sched_date, dtime, sizeof(struct wwv_date)))
+        return &wwv_dat->sched;
+
+    wwv_dat->sched_valid = 0;
+    if (wwv_enc_frame(&wwv_dat->sched, proto, dtime)) return NULL;
+
+    wwv_dat->sched_date = *dtime;
+    wwv_dat->sched_valid = 1;
+
+    return &wwv_dat->sched;
+}
+
+/*
+ * Adds a timing error in ns to a histogram. Buckets are powers of two
+ * in usecs. Called from the hrtimer callback on this CPU's copy inside
+ * its syncp update, so no locking is needed.
+ */
+static void wwv_hist_add(struct wwv_hist *hist, s64 ns)
+{
+    u64 mag = ns < 0 ? -ns : ns;
+    int b = fls64(div_u64(mag, 1000));
+
+    if (b >= WWV_HIST_BUCKETS) b = WWV_HIST_BUCKETS - 1;
+    if (ns < 0) {
+        hist->early[b]++;
+    } else {
+        hist->late[b]++;
+    }
+    if (hist->count == 0 || ns < hist->min) hist->min = ns;
+    if (hist->count == 0 || ns > hist->max) hist->max = ns;
+    hist->sum += ns;
+    hist->count++;
+}
+
+/*
+ * Returns which pulse width histogram a run length belongs to in a
+ * format, or -1 if it is not one of the bit envelopes or the schedule
+ * is a waveform from userspace with no format.
+ */
+static int wwv_pulse_class(const struct wwv_proto *proto, u32 usecs)
+{
+    int sym;
+
+    if (proto == NULL) return -1;
+
+    for (sym = 0; sym < WWV_PULSE_KINDS; sym++) {
+        if (proto->sym[sym].on_us && usecs == proto->sym[sym].on_us) return sym;
+    }
+
+    return -1;
+}
+
+/*
+ * Timing stats for one engine tick. now is when the tick ran, done is
+ * set if the frame just ended.
+ */
+static void wwv_engine_stats(struct wwv_engine *eng, ktime_t now, int run_start, int done)
+{
+    struct wwv_stats *st = this_cpu_ptr(eng->stats);
+    const struct wwv_proto *proto = eng->cur.sched->proto;
+    const struct wwv_run *run;
+    int class;
+
+    u64_stats_update_begin(&st->syncp);
+
+    // How late this edge is against the time it was scheduled for
+    wwv_hist_add(&st->late, ktime_to_ns(ktime_sub(now, eng->next)));
+
+    if (!run_start && !done) goto out;
+
+    // The run holding a pulse just ended
+    if (eng->pulse_class >= 0) {
+        wwv_hist_add(&st->width[eng->pulse_class],
+                     ktime_to_ns(ktime_sub(now, eng->pulse_start)) - eng->pulse_ns);
+        eng->pulse_class = -1;
+    }
+
+    if (done) {
+        wwv_hist_add(&st->frame, ktime_to_ns(ktime_sub(now, eng->actual_start)) -
+                     ktime_to_ns(ktime_sub(eng->next, eng->start)));
+
+        // Where the next frame is due to start. Every edge is placed
+        // from the frame start, so this only adds up if the layout's
+        // slots don't fill the period.
+        if (proto != NULL)
+            wwv_hist_add(&st->slip, ktime_to_ns(ktime_sub(now, eng->start)) -
+                         div_u64((u64)proto->period_us * NSEC_PER_USEC, eng->cur.scale));
+        goto out;
+    }
+
+    // A new pulse starts
+    run = &eng->cur.sched->run[eng->cur.idx - 1];
+    class = wwv_pulse_class(proto, run->usecs);
+    if (run->level != WWV_LVL_LOW && class >= 0) {
+        trace_wwv_symbol(eng->minor, eng->cur.idx - 1, class, ktime_to_ns(eng->next), ktime_to_ns(now));
+        eng->pulse_class = class;
+        eng->pulse_start = now;
+        eng->pulse_ns = div_s64((s64)run->usecs * 1000, eng->cur.scale);
+    }
+
+out:
+    u64_stats_update_end(&st->syncp);
+}
+
+/*
+ * Sets the engine's pin, through the GPIO registers when the instance
+ * mapped them and through gpiolib otherwise. A pin on a chip that may
+ * sleep (gpio-mockup, gpio-sim, an I2C expander) can't be set from the
+ * timer, so it is handed to pin_work.
+ */
+static inline void wwv_engine_set(struct wwv_engine *eng, int level)
+{
+    if (eng->use_mmio) {
+        wwv_mmio_pin_set(&eng->mmio, level);
+    } else if (eng->pin_sleeps) {
+        WRITE_ONCE(eng->pin_level, level);
+        queue_work(system_highpri_wq, &eng->pin_work);
+    } else {
+        gpiod_set_value(eng->pin, level);
+    }
+}
+
+/*
+ * Sets a pin whose chip may sleep. Edges that come faster than the
+ * worker runs are merged, but the pin always ends at the engine's
+ * last level.
+ */
+static void wwv_engine_pin_work(struct work_struct *work)
+{
+    struct wwv_engine *eng = container_of(work, struct wwv_engine, pin_work);
+
+    gpiod_set_value_cansleep(eng->pin, READ_ONCE(eng->pin_level));
+}
+
+/*
+ * Names how the engine sets its pin, for sysfs and the probe log.
+ */
+static const char *wwv_engine_backend(struct wwv_engine *eng)
+{
+    if (eng->use_mmio) return "mmio";
+    return eng->pin_sleeps ? "gpiod-cansleep" : "gpiod";
+}
+
+/*
+ * Logs a pin transition with its kernel time, if the edge log is on.
+ * Only the timer writes the log, so it needs no lock against itself.
+ */
+static void wwv_engine_log(struct wwv_engine *eng, ktime_t now, int level)
+{
+    struct wwv_edge *edge;
+    u32 head = eng->log_head;
+
+    if (eng->log == NULL || level == eng->log_level) return;
+    eng->log_level = level;
+
+    // Pairs with the reader's store of log_tail once it's copied out
+    if (head - smp_load_acquire(&eng->log_tail) >= eng->log_len) {
+        eng->log_dropped++;
+        return;
+    }
+    edge = &eng->log[head & (eng->log_len - 1)];
+    edge->t = ktime_to_ns(now);
+    edge->level = level;
+    edge->pad = 0;
+    smp_store_release(&eng->log_head, head + 1);
+}
+
+/*
+ * Ends the schedule early, leaves the pin low and wakes the sender.
+ * Called from the timer, or with it stopped.
+ */
+static void wwv_engine_cut(struct wwv_engine *eng, ktime_t now)
+{
+    wwv_engine_set(eng, 0);
+    wwv_engine_log(eng, now, 0);
+    eng->cut = 1;
+    // The frame ends here, so one chained after it starts now
+    eng->next = now;
+    if (eng->cur.idx != 0 || eng->cur.half != 0)
+        trace_wwv_frame_end(eng->minor, ktime_to_ns(eng->actual_start), ktime_to_ns(now), 1);
+    WRITE_ONCE(eng->done, 1);
+    wake_up(&eng->wait);
+}
+
+/*
+ * hrtimer callback that runs the schedule. Every edge is placed at
+ * an absolute time worked out from the start of the frame, so a late
+ * wakeup delays only that edge and never the ones after it.
+ */
+static enum hrtimer_restart wwv_engine_tick(struct hrtimer *timer)
+{
+    struct wwv_engine *eng = container_of(timer, struct wwv_engine, timer);
+    ktime_t now = ktime_get();
+    int idx = eng->cur.idx;
+    int done;
+
+    if (eng->cur.idx == 0 && eng->cur.half == 0) {
+        eng->actual_start = now;
+        trace_wwv_frame_start(eng->minor, ktime_to_ns(eng->start), ktime_to_ns(now), eng->cur.scale);
+    }
+
+    // Called off, stop at the end of the run on the pin. The pulse in
+    // it, if any, has just finished so no symbol is left half sent.
+    if (READ_ONCE(eng->abort) && eng->cur.half == 0) {
+        wwv_engine_cut(eng, now);
+        return HRTIMER_NORESTART;
+    }
+
+    // End of the schedule or the cut off, leave the pin low and wake
+    // the sender
+    done = wwv_cursor_step(&eng->cur);
+    if (done || (eng->end && !ktime_before(eng->next, eng->end))) {
+        wwv_engine_set(eng, 0);
+        wwv_engine_log(eng, now, 0);
+        wwv_engine_stats(eng, now, 0, 1);
+        trace_wwv_frame_end(eng->minor, ktime_to_ns(eng->actual_start), ktime_to_ns(now), 0);
+        WRITE_ONCE(eng->done, 1);
+        wake_up(&eng->wait);
+        return HRTIMER_NORESTART;
+    }
+
+    wwv_engine_set(eng, eng->cur.level);
+    wwv_engine_log(eng, now, eng->cur.level);
+    wwv_engine_stats(eng, now, eng->cur.idx != idx, 0);
+
+    eng->next = ktime_add_ns(eng->start, eng->cur.t);
+    if (eng->end && ktime_after(eng->next, eng->end)) eng->next = eng->end;
+    hrtimer_set_expires(timer, eng->next);
+
+    return HRTIMER_RESTART;
+}
+
+/*
+ * Sets up the timing engine to drive a pin. If regs is not NULL it
+ * must be the mapped GPIO block of the pin's chip (see
+ * wwv_pin_regs()), and edges are written to it directly.
+ */
+static void wwv_engine_init(struct wwv_engine *eng, struct gpio_desc *pin, void __iomem *regs)
+{
+    struct gpio_chip *chip = gpiod_to_chip(pin);
+
+    hrtimer_init(&eng->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+    eng->timer.function = wwv_engine_tick;
+    init_waitqueue_head(&eng->wait);
+    spin_lock_init(&eng->lock);
+    eng->pin = pin;
+    eng->scale = 1;
+    mutex_init(&eng->log_read);
+
+    // The registers are numbered by the pin's offset in its chip
+    if (regs != NULL && chip != NULL &&
+        wwv_mmio_pin_init(&eng->mmio, regs, desc_to_gpio(pin) - chip->base) == 0)
+        eng->use_mmio = 1;
+
+    INIT_WORK(&eng->pin_work, wwv_engine_pin_work);
+    eng->pin_sleeps = !eng->use_mmio && gpiod_cansleep(pin);
+}
+
+/*
+ * Starts the engine on a compiled schedule. The first run starts at
+ * the monotonic time start. If end is not zero the schedule is cut
+ * short there. Returns 0 if it was armed, -ESHUTDOWN if the engine is
+ * halted and -ECANCELED if the frame was cancelled since its sender
+ * took the pin (see wwv_take_pin()).
+ */
+static int wwv_arm_sched(struct wwv_engine *eng, struct wwv_sched *sched, ktime_t start, ktime_t end)
+{
+    spin_lock(&eng->lock);
+    if (eng->halted) {
+        spin_unlock(&eng->lock);
+        return -ESHUTDOWN;
+    }
+    if (eng->abort) {
+        spin_unlock(&eng->lock);
+        return -ECANCELED;
+    }
+
+    wwv_cursor_init(&eng->cur, sched, READ_ONCE(eng->scale));
+    eng->pulse_class = -1;
+    eng->done = 0;
+    eng->cut = 0;
+    eng->start = start;
+    eng->next = start;
+    eng->end = end;
+
+    hrtimer_start(&eng->timer, eng->next, HRTIMER_MODE_ABS);
+    spin_unlock(&eng->lock);
+
+    return 0;
+}
+
+/*
+ * Stops the engine's schedule early. One still waiting for its first
+ * edge, or with the pin low between pulses, is stopped at once, so a
+ * long blank is never waited out. One in the middle of a pulse stops
+ * at the end of it. Does nothing if the engine is idle. Safe in atomic
+ * context, but not from the timer.
+ */
+static void wwv_engine_abort(struct wwv_engine *eng)
+{
+    spin_lock(&eng->lock);
+    WRITE_ONCE(eng->abort, 1);
+
+    // Waits out a tick in progress, so the cursor is still. The timer
+    // is re-armed between edges, so it being stopped here doesn't mean
+    // the frame hadn't started.
+    if (hrtimer_cancel(&eng->timer)) {
+        if (eng->cur.half == 0 && eng->cur.level == 0) {
+            wwv_engine_cut(eng, ktime_get());
+        } else {
+            hrtimer_start(&eng->timer, eng->next, HRTIMER_MODE_ABS);
+        }
+    }
+    spin_unlock(&eng->lock);
+}
+
+/*
+ * Halts the engine, or lets it run again. A halt stops the schedule
+ * on the pin at once, mid pulse if need be, and leaves the pin low.
+ * Nothing can be armed until the engine is let go. Safe in atomic
+ * context.
+ */
+static void wwv_engine_halt(struct wwv_engine *eng, int on)
+{
+    spin_lock(&eng->lock);
+    WRITE_ONCE(eng->halted, on);
+    if (!on) {
+        spin_unlock(&eng->lock);
+        return;
+    }
+
+    // Waits out a tick in progress so it can't raise the pin after
+    if (hrtimer_cancel(&eng->timer)) wwv_engine_cut(eng, ktime_get());
+    wwv_engine_set(eng, 0);
+    spin_unlock(&eng->lock);
+}
+
+/*
+ * Sleeps until the armed schedule is finished. A signal stops it as
+ * soon as no pulse is on the pin. Returns 0 if the whole frame was sent,
+ * -ESHUTDOWN if the Shutdown input cut it short, -ECANCELED if
+ * WWV_CANCEL or a more urgent frame did, -EINTR if a signal cut it
+ * short and -ERESTARTSYS if a signal called it off before the first
+ * edge.
+ */
+static int wwv_wait_sched(struct wwv_engine *eng)
+{
+    int intr = 0;
+
+    if (wait_event_interruptible(eng->wait, READ_ONCE(eng->done))) {
+        intr = 1;
+        wwv_engine_abort(eng);
+        wait_event(eng->wait, READ_ONCE(eng->done));
+    }
+
+    if (!eng->cut) return 0;
+    if (READ_ONCE(eng->halted)) return -ESHUTDOWN;
+    if (!intr) return -ECANCELED;
+    return eng->cur.idx == 0 && eng->cur.half == 0 ? -ERESTARTSYS : -EINTR;
+}
+
+/*
+ * Plays a compiled schedule out on the engine's pin and sleeps until
+ * the last run is finished. Returns as wwv_wait_sched().
+ */
+static int wwv_play_sched(struct wwv_engine *eng, struct wwv_sched *sched, ktime_t start, ktime_t end)
+{
+    int ret;
+
+    ret = wwv_arm_sched(eng, sched, start, end);
+    if (ret) return ret;
+    return wwv_wait_sched(eng);
+}
+
+/*
+ * Takes the channel's pin for a frame, with wwv_admit_enter() flags
+ * and return values. A cancel from before the pin was ours was meant
+ * for the frame before, so it is cleared here. One from after is kept
+ * for wwv_arm_sched(), however long the frame takes to compile.
+ */
+static int wwv_take_pin(struct wwv_data_t *wwv_dat, int flags)
+{
+    int ret;
+
+    ret = wwv_admit_enter(&wwv_dat->admit, flags);
+    if (ret == 0) {
+        spin_lock(&wwv_dat->eng.lock);
+        WRITE_ONCE(wwv_dat->eng.abort, 0);
+        spin_unlock(&wwv_dat->eng.lock);
+    }
+
+    return ret;
+}
+
+/*
+ * Takes the oldest frame off the shared mmap() ring. Invalid stamps
+ * are skipped and counted in the ring's dropped field. Returns 0 if a
+ * frame was taken, 1 if the ring is empty. Called with qlock held.
+ */
+static int wwv_ring_take(struct wwv_data_t *wwv_dat, struct wwv_date *dtime)
+{
+    struct wwv_ring *ring = wwv_dat->ring;
+    struct wwv_stamp stamp;
+    u32 head;
+    u32 tail;
+
+    // The driver's own copy of tail is used, the one in the shared
+    // page is only there for the producer to read
+    tail = wwv_dat->ring_tail;
+    for (;;) {
+        // Pairs with the producer's store of head after it fills a slot
+        head = smp_load_acquire(&ring->head);
+        if (head == tail) return 1;
+
+        // The producer moved head somewhere impossible, drop it all
+        if (head - tail > WWV_RING_SLOTS) {
+            ring->dropped += head - tail;
+            wwv_dat->ring_tail = head;
+            smp_store_release(&ring->tail, head);
+            return 1;
+        }
+
+        memcpy(&stamp, &ring->stamp[tail % WWV_RING_SLOTS], sizeof(stamp));
+        tail++;
+        wwv_dat->ring_tail = tail;
+        smp_store_release(&ring->tail, tail);
+
+        if (wwv_conv_stamp(&stamp, dtime) == 0) break;
+        ring->dropped++;
+    }
+
+    // Make the new tail visible before the caller looks at head again,
+    // so a producer that saw the ring as non-empty is never missed
+    smp_mb();
+
+    return 0;
+}
+
+/*
+ * Takes the oldest frame off the transmit queue, then the mmap() ring.
+ * Returns 0 if a frame was taken, 1 if both are empty or the channel
+ * is shut down.
+ */
+static int wwv_dequeue(struct wwv_data_t *wwv_dat, struct wwv_date *dtime)
+{
+    int ret = 1;
+
+    spin_lock(&wwv_dat->qlock);
+    if (wwv_dat->stopping || READ_ONCE(wwv_dat->eng.halted)) {
+        // Nothing more goes out
+    } else if (wwv_dat->q_head != wwv_dat->q_tail) {
+        *dtime = wwv_dat->queue[wwv_dat->q_tail % WWV_QUEUE_LEN];
+        wwv_dat->q_tail++;
+        ret = 0;
+    } else if (!wwv_dat->broadcast && wwv_ring_take(wwv_dat, dtime) == 0) {
+        wwv_dat->submitted++;
+        ret = 0;
+    }
+    if (ret == 0) wwv_dat->active = 1;
+    spin_unlock(&wwv_dat->qlock);
+
+    // A slot opened up for writers
+    if (ret == 0) wake_up_interruptible(&wwv_dat->pollq);
+
+    return ret;
+}
+
+/*
+ * Work item that drains the transmit queue. Frames go out back to
+ * back until the queue is empty.
+ */
+static void wwv_tx_work(struct work_struct *work)
+{
+    struct wwv_data_t *wwv_dat = container_of(work, struct wwv_data_t, work);
+    struct wwv_date dtime;
+    struct wwv_sched *sched;
+    ktime_t start;
+    ktime_t now;
+    int chained = 0;
+
+    while (wwv_dequeue(wwv_dat, &dtime) == 0) {
+        wwv_take_pin(wwv_dat, WWV_ADMIT_KERNEL);
+        sched = wwv_get_sched(wwv_dat, &dtime);
+        if (sched != NULL) {
+            // A frame that was already waiting starts exactly where the
+            // last one ended, so there is no gap between them
+            now = ktime_get();
+            start = wwv_dat->eng.next;
+            if (!chained || ktime_before(ktime_add_ns(start, WWV_CHAIN_SLACK_NS), now)) start = now;
+
+            // A halt that came in since the frame was taken drops it
+            if (wwv_arm_sched(&wwv_dat->eng, sched, start, 0) == 0) {
+                // Only now can a more urgent frame preempt it
+                spin_lock(&wwv_dat->qlock);
+                wwv_dat->on_pin = 1;
+                spin_unlock(&wwv_dat->qlock);
+                wwv_wait_sched(&wwv_dat->eng);
+                spin_lock(&wwv_dat->qlock);
+                wwv_dat->on_pin = 0;
+                spin_unlock(&wwv_dat->qlock);
+            } else {
+                sched = NULL;
+            }
+        }
+        chained = (sched != NULL);
+        wwv_admit_exit(&wwv_dat->admit);
+
+        // Report the completion to poll()
+        spin_lock(&wwv_dat->qlock);
+        wwv_dat->completed++;
+        wwv_dat->active = 0;
+        spin_unlock(&wwv_dat->qlock);
+        wake_up_interruptible(&wwv_dat->pollq);
+    }
+}
+
+/*
+ * Converts a CLOCK_REALTIME time to the CLOCK_MONOTONIC time the
+ * engine runs on.
+ */
+static ktime_t wwv_real_to_mono(ktime_t real)
+{
+    return ktime_sub(real, ktime_mono_to_real(0));
+}
+
+/*
+ * Returns 1 if the device is in broadcast mode. Frames from
+ * userspace are refused while it is.
+ */
+static int wwv_broadcasting(struct wwv_data_t *wwv_dat)
+{
+    return READ_ONCE(wwv_dat->broadcast);
+}
+
+/*
+ * Returns 1 while the Shutdown input is asserted. Every new frame is
+ * refused with -ESHUTDOWN until it's released.
+ */
+static int wwv_shut_down(struct wwv_data_t *wwv_dat)
+{
+    return READ_ONCE(wwv_dat->eng.halted);
+}
+
+/*
+ * Turns broadcast mode off from the worker when it can't go on, so
+ * sysfs doesn't report a broadcast that isn't running and it can be
+ * turned on again.
+ */
+static void wwv_bcast_stop(struct wwv_data_t *wwv_dat, const char *why)
+{
+    spin_lock(&wwv_dat->qlock);
+    WRITE_ONCE(wwv_dat->broadcast, 0);
+    spin_unlock(&wwv_dat->qlock);
+    printk(KERN_INFO "wwv%d: broadcast stopped, %s\n", wwv_dat->minor, why);
+}
+
+/*
+ * Work item for broadcast mode. Sends a frame for every frame period
+ * of the channel's format (a minute, or a second for IRIG-B), each one
+ * starting on the boundary by the kernel's UTC, until broadcast mode
+ * is turned off.
+ */
+static void wwv_bcast_work(struct work_struct *work)
+{
+    struct wwv_data_t *wwv_dat = container_of(work, struct wwv_data_t, bcast_work);
+    const struct wwv_proto *proto;
+    struct tm utc;
+    struct wwv_date dtime;
+    struct wwv_sched *sched;
+    s64 period;
+    s64 from;
+    s64 boundary;
+    ktime_t start;
+    int chained = 0;
+    int ret;
+
+    while (wwv_broadcasting(wwv_dat)) {
+        // Next boundary. Right after a frame was cut off that's the
+        // boundary it was cut at, so no frame is skipped.
+        proto = READ_ONCE(wwv_dat->proto);
+        period = (s64)proto->period_us * NSEC_PER_USEC;
+        from = ktime_to_ns(ktime_get_real());
+        if (chained) from -= WWV_CHAIN_SLACK_NS;
+        boundary = (div64_s64(from, period) + 1) * period;
+
+        time64_to_tm(div_s64(boundary, NSEC_PER_SEC), 0, &utc);
+        utc.tm_yday++;
+        if (wwv_conv_date(&utc, &dtime)) {
+            wwv_bcast_stop(wwv_dat, "the date can't be sent");
+            break;
+        }
+
+        start = wwv_real_to_mono(ns_to_ktime(boundary));
+
+        // Frame is cut off at the next boundary so the one after it
+        // can start on time
+        wwv_take_pin(wwv_dat, WWV_ADMIT_KERNEL);
+        sched = wwv_get_sched(wwv_dat, &dtime);
+        ret = -EINVAL;
+        if (sched != NULL)
+            ret = wwv_arm_sched(&wwv_dat->eng, sched, start, ktime_add_ns(start, period));
+        if (ret == 0) {
+            // Broadcast mode may have been turned off before the frame
+            // was armed, too early for wwv_set_broadcast() to call it off
+            if (!wwv_broadcasting(wwv_dat)) wwv_engine_abort(&wwv_dat->eng);
+            ret = wwv_wait_sched(&wwv_dat->eng);
+        }
+        wwv_admit_exit(&wwv_dat->admit);
+        if (sched == NULL) wwv_bcast_stop(wwv_dat, "the frame does not fit");
+        if (sched == NULL || ret == -ESHUTDOWN) break;
+
+        // A frame cancelled early ended short of the boundary, and
+        // one cancelled before it was armed never started
+        chained = ret != -ECANCELED && !wwv_dat->eng.cut;
+    }
+}
+
+/*
+ * Turns broadcast mode on or off. Turning it off stops the frame on
+ * the pin the way WWV_CANCEL does, at the end of the pulse on it, and
+ * returns once the worker has stopped.
+ */
+static int wwv_set_broadcast(struct wwv_data_t *wwv_dat, int on)
+{
+    int was;
+
+    if (on && wwv_shut_down(wwv_dat)) return -ESHUTDOWN;
+
+    spin_lock(&wwv_dat->qlock);
+    if (on && (wwv_dat->q_head != wwv_dat->q_tail || wwv_dat->active ||
+               wwv_dat->eng.scale != 1)) {
+        spin_unlock(&wwv_dat->qlock);
+        return -EBUSY;
+    }
+    was = wwv_dat->broadcast;
+    WRITE_ONCE(wwv_dat->broadcast, on ? 1 : 0);
+    spin_unlock(&wwv_dat->qlock);
+
+    if (on) {
+        queue_work(wwv_dat->wq, &wwv_dat->bcast_work);
+    } else if (was) {
+        // Only the worker's frames reach the pin in broadcast mode
+        wwv_engine_abort(&wwv_dat->eng);
+        flush_work(&wwv_dat->bcast_work);
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 1 if the transmit queue has room for count frames.
+ */
+static int wwv_queue_room(struct wwv_data_t *wwv_dat, unsigned int count)
+{
+    int room;
+
+    spin_lock(&wwv_dat->qlock);
+    room = WWV_QUEUE_LEN - (wwv_dat->q_head - wwv_dat->q_tail) >= count;
+    spin_unlock(&wwv_dat->qlock);
+
+    return room;
+}
+
+/*
+ * Puts count already checked dates on the transmit queue as one
+ * unit, so they go out back to back. If there is not room for all
+ * of them, O_NONBLOCK callers get -EAGAIN and everyone else waits.
+ */
+static long wwv_enqueue(struct file *filp, struct wwv_data_t *wwv_dat, struct wwv_date *dtime, unsigned int count)
+{
+    unsigned int i;
+    int queued = 0;
+
+    while (!queued) {
+        spin_lock(&wwv_dat->qlock);
+        if (wwv_dat->stopping) {
+            spin_unlock(&wwv_dat->qlock);
+            return -ENODEV;
+        }
+        if (wwv_shut_down(wwv_dat)) {
+            spin_unlock(&wwv_dat->qlock);
+            return -ESHUTDOWN;
+        }
+        if (wwv_dat->broadcast) {
+            spin_unlock(&wwv_dat->qlock);
+            return -EBUSY;
+        }
+        if (WWV_QUEUE_LEN - (wwv_dat->q_head - wwv_dat->q_tail) >= count) {
+            for (i = 0; i < count; i++) {
+                wwv_dat->queue[wwv_dat->q_head % WWV_QUEUE_LEN] = dtime[i];
+                wwv_dat->q_head++;
+            }
+            wwv_dat->submitted += count;
+            queued = 1;
+            trace_wwv_submit(wwv_dat->minor, WWV_TR_QUEUE, count);
+        }
+        spin_unlock(&wwv_dat->qlock);
+
+        if (queued) break;
+        if (filp->f_flags & O_NONBLOCK) return -EAGAIN;
+        if (wait_event_interruptible(wwv_dat->pollq, wwv_queue_room(wwv_dat, count)))
+            return -ERESTARTSYS;
+    }
+
+    queue_work(wwv_dat->wq, &wwv_dat->work);
+
+    return 0;
+}
+
+/*
+ * WWV_SUBMIT: validates a date and puts it on the transmit queue,
+ * then returns without waiting for it to be sent.
+ */
+static long wwv_submit(struct file *filp, struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct tm utc;
+    struct wwv_date dtime;
+
+    if (copy_from_user(&utc, (struct tm *)arg, sizeof(struct tm))) return -EFAULT;
+    if (wwv_conv_date(&utc, &dtime)) return -EINVAL;
+
+    return wwv_enqueue(filp, wwv_dat, &dtime, 1);
+}
+
+/*
+ * WWV_TRANSMIT_BATCH: checks every timestamp in the batch and queues
+ * them all to be sent back to back. Nothing is queued unless all of
+ * them are valid.
+ */
+static long wwv_submit_batch(struct file *filp, struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct wwv_batch *batch;
+    struct wwv_date *dtime = NULL;
+    unsigned int i;
+    long ret;
+
+    // Allocate memory for the userspace batch
+    batch = kmalloc(sizeof(struct wwv_batch), GFP_KERNEL);
+    if (batch == NULL) return -ENOMEM;
+
+    if (copy_from_user(batch, (struct wwv_batch *)arg, sizeof(struct wwv_batch))) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    if (batch->version != WWV_BATCH_VERSION || batch->count == 0 || batch->count > WWV_BATCH_MAX) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    // Allocate memory for the converted dates
+    dtime = kmalloc_array(batch->count, sizeof(struct wwv_date), GFP_KERNEL);
+    if (dtime == NULL) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    for (i = 0; i < batch->count; i++) {
+        if (wwv_conv_stamp(&batch->stamps[i], &dtime[i])) {
+            ret = -EINVAL;
+            goto out;
+        }
+    }
+
+    ret = wwv_enqueue(filp, wwv_dat, dtime, batch->count);
+
+out:
+    kfree(dtime);
+    kfree(batch);
+
+    return ret;
+}
+
+/*
+ * WWV_SUBMIT_URGENT: queues one frame ahead of every frame already
+ * waiting. An urgent frame never waits for room. With
+ * WWV_URGENT_PREEMPT a queued frame on the pin is stopped as soon as
+ * no pulse is on it, so this one follows it straight away.
+ */
+static long wwv_submit_urgent(struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct wwv_urgent urg;
+    struct wwv_date dtime;
+    long ret = 0;
+
+    if (copy_from_user(&urg, (struct wwv_urgent *)arg, sizeof(urg))) return -EFAULT;
+    if (urg.pad != 0 || (urg.flags & ~WWV_URGENT_PREEMPT)) return -EINVAL;
+    if (wwv_conv_stamp(&urg.stamp, &dtime)) return -EINVAL;
+
+    spin_lock(&wwv_dat->qlock);
+    if (wwv_shut_down(wwv_dat)) {
+        ret = -ESHUTDOWN;
+    } else if (wwv_dat->broadcast) {
+        ret = -EBUSY;
+    } else if (wwv_dat->q_head - wwv_dat->q_tail >= WWV_QUEUE_LEN) {
+        ret = -EAGAIN;
+    } else {
+        wwv_dat->q_tail--;
+        wwv_dat->queue[wwv_dat->q_tail % WWV_QUEUE_LEN] = dtime;
+        wwv_dat->submitted++;
+        trace_wwv_submit(wwv_dat->minor, WWV_TR_URGENT, 1);
+
+        // Only the worker's own frames are preempted, never a
+        // WWV_TRANSMIT caller's
+        if ((urg.flags & WWV_URGENT_PREEMPT) && wwv_dat->on_pin) wwv_engine_abort(&wwv_dat->eng);
+    }
+    spin_unlock(&wwv_dat->qlock);
+
+    if (ret == 0) queue_work(wwv_dat->wq, &wwv_dat->work);
+
+    return ret;
+}
+
+/*
+ * WWV_CANCEL: stops the frame on the pin once no pulse is on it,
+ * whoever sent it, and/or drops every frame waiting on the queue.
+ * Dropped frames count as completed so poll() waiters see them go.
+ */
+static long wwv_cancel(struct wwv_data_t *wwv_dat, int what)
+{
+    unsigned int dropped = 0;
+
+    if (what == 0 || (what & ~(WWV_CANCEL_PIN | WWV_CANCEL_QUEUE))) return -EINVAL;
+
+    if (what & WWV_CANCEL_QUEUE) {
+        spin_lock(&wwv_dat->qlock);
+        dropped = wwv_dat->q_head - wwv_dat->q_tail;
+        wwv_dat->q_tail = wwv_dat->q_head;
+        wwv_dat->completed += dropped;
+        spin_unlock(&wwv_dat->qlock);
+    }
+    if (what & WWV_CANCEL_PIN) wwv_engine_abort(&wwv_dat->eng);
+
+    if (dropped) wake_up_interruptible(&wwv_dat->pollq);
+
+    return 0;
+}
+
+/*
+ * Follows the Shutdown input. Asserting it stops the frame on the pin
+ * at once with the pin low, drops every queued frame and turns
+ * broadcast mode off. Releasing it lets frames out again, starting
+ * with any left on the mmap() ring.
+ */
+static void wwv_chan_shutdown(struct wwv_data_t *wwv_dat, int on)
+{
+    unsigned int dropped = 0;
+
+    // Halted first, so nothing queued from here on gets past it
+    wwv_engine_halt(&wwv_dat->eng, on);
+
+    if (on) {
+        spin_lock(&wwv_dat->qlock);
+        dropped = wwv_dat->q_head - wwv_dat->q_tail;
+        wwv_dat->q_tail = wwv_dat->q_head;
+        wwv_dat->completed += dropped;
+        WRITE_ONCE(wwv_dat->broadcast, 0);
+        spin_unlock(&wwv_dat->qlock);
+        if (dropped) wake_up_interruptible(&wwv_dat->pollq);
+    } else {
+        queue_work(wwv_dat->wq, &wwv_dat->work);
+    }
+}
+
+/*
+ * WWV_STATUS: copies the queue counters to userspace. This also
+ * clears the completion event that poll() reports for this file.
+ */
+static long wwv_status(struct wwv_file *wf, unsigned long arg)
+{
+    struct wwv_data_t *wwv_dat = wf->wwv_dat;
+    struct wwv_status st;
+
+    memset(&st, 0, sizeof(st));
+
+    spin_lock(&wwv_dat->qlock);
+    st.queued = wwv_dat->q_head - wwv_dat->q_tail;
+    st.active = wwv_dat->active;
+    st.submitted = wwv_dat->submitted;
+    st.completed = wwv_dat->completed;
+    wf->seen = wwv_dat->completed;
+    spin_unlock(&wwv_dat->qlock);
+
+    if (copy_to_user((struct wwv_status *)arg, &st, sizeof(st))) return -EFAULT;
+
+    return 0;
+}
+
+/*
+ * WWV_ADMIT_STATS: copies the pin admission counters to userspace.
+ */
+static long wwv_admit_stats(struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct wwv_admit *adm = &wwv_dat->admit;
+    struct wwv_admit_stats st;
+
+    memset(&st, 0, sizeof(st));
+
+    spin_lock(&adm->lock);
+    st.depth = adm->depth;
+    st.busy = adm->busy;
+    st.admitted = adm->admitted;
+    st.rejected = adm->rejected;
+    st.timedout = adm->timedout;
+    st.interrupted = adm->interrupted;
+    st.wait_ns = adm->wait_ns;
+    st.wait_max_ns = adm->wait_max_ns;
+    spin_unlock(&adm->lock);
+
+    if (copy_to_user((struct wwv_admit_stats *)arg, &st, sizeof(st))) return -EFAULT;
+
+    return 0;
+}
+
+/*
+ * WWV_SET_PROTO: picks the timecode format. Frames already on the pin
+ * finish in the old one, everything after goes out in the new one.
+ */
+static long wwv_set_proto(struct wwv_data_t *wwv_dat, int id)
+{
+    const struct wwv_proto *proto = wwv_proto_get(id);
+
+    if (proto == NULL) return -EINVAL;
+    WRITE_ONCE(wwv_dat->proto, proto);
+
+    return 0;
+}
+
+/*
+ * WWV_SET_SCALE: sends frames scale times faster than real time, for
+ * test runs against a decoder set to the same scale. Frames already
+ * on the pin finish at the old scale. Broadcast frames follow the
+ * wall clock, so the two can't be mixed.
+ */
+static long wwv_set_scale(struct wwv_data_t *wwv_dat, int scale)
+{
+    if (scale < 1 || scale > WWV_SCALE_MAX) return -EINVAL;
+
+    spin_lock(&wwv_dat->qlock);
+    if (wwv_dat->broadcast) {
+        spin_unlock(&wwv_dat->qlock);
+        return -EBUSY;
+    }
+    WRITE_ONCE(wwv_dat->eng.scale, scale);
+    spin_unlock(&wwv_dat->qlock);
+
+    return 0;
+}
+
+/*
+ * WWV_TRANSMIT_AT: sends one frame with its first edge at an absolute
+ * CLOCK_REALTIME or CLOCK_TAI time, then reports how late it was.
+ */
+static long wwv_transmit_at(struct file *filp, struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct wwv_at at;
+    struct wwv_date dtime;
+    struct wwv_sched *sched;
+    ktime_t start;
+    long ret;
+
+    if (copy_from_user(&at, (struct wwv_at *)arg, sizeof(at))) return -EFAULT;
+    if (at.pad != 0 || (at.clock != CLOCK_REALTIME && at.clock != CLOCK_TAI)) return -EINVAL;
+    if (wwv_conv_stamp(&at.stamp, &dtime)) return -EINVAL;
+    if (wwv_shut_down(wwv_dat)) return -ESHUTDOWN;
+    if (wwv_broadcasting(wwv_dat)) return -EBUSY;
+
+    trace_wwv_submit(wwv_dat->minor, WWV_TR_AT, 1);
+    ret = wwv_take_pin(wwv_dat, (filp->f_flags & O_NONBLOCK) ? WWV_ADMIT_NONBLOCK : 0);
+    if (ret) return ret;
+
+    // Converted once the pin is ours, so a clock step while waiting
+    // for it is still followed
+    if (at.clock == CLOCK_TAI) {
+        start = ktime_sub(ns_to_ktime(at.start_ns), ktime_mono_to_any(0, TK_OFFS_TAI));
+    } else {
+        start = wwv_real_to_mono(ns_to_ktime(at.start_ns));
+    }
+    // A start the last frame ran right up to is still taken, so
+    // frames a period long can be sent back to back
+    if (ktime_before(ktime_add_ns(start, WWV_CHAIN_SLACK_NS), ktime_get())) {
+        ret = -ETIME;
+        goto out;
+    }
+
+    sched = wwv_get_sched(wwv_dat, &dtime);
+    if (sched == NULL) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ret = wwv_play_sched(&wwv_dat->eng, sched, start, 0);
+    if (ret == 0) {
+        at.late_ns = ktime_to_ns(ktime_sub(wwv_dat->eng.actual_start, start));
+        if (copy_to_user((struct wwv_at *)arg, &at, sizeof(at))) ret = -EFAULT;
+    }
+
+out:
+    wwv_admit_exit(&wwv_dat->admit);
+    return ret;
+}
+
+/*
+ * WWV_TRANSMIT_RLE: plays a waveform built in userspace on the pin.
+ * It's loaded into a schedule of its own, so the channel's cached
+ * frame is left alone, and otherwise goes out like WWV_TRANSMIT.
+ */
+static long wwv_transmit_rle(struct file *filp, struct wwv_data_t *wwv_dat, unsigned long arg)
+{
+    struct wwv_rle *rle;
+    struct wwv_sched *sched;
+    long ret;
+
+    BUILD_BUG_ON(WWV_RLE_MAX > WWV_SCHED_MAX);
+
+    if (wwv_shut_down(wwv_dat)) return -ESHUTDOWN;
+    if (wwv_broadcasting(wwv_dat)) return -EBUSY;
+
+    rle = kmalloc(sizeof(struct wwv_rle), GFP_KERNEL);
+    sched = kmalloc(sizeof(struct wwv_sched), GFP_KERNEL);
+    if (rle == NULL || sched == NULL) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    if (copy_from_user(rle, (struct wwv_rle *)arg, sizeof(struct wwv_rle))) {
+        ret = -EFAULT;
+        goto out;
+    }
+    if (wwv_rle_load(sched, rle)) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    trace_wwv_submit(wwv_dat->minor, WWV_TR_RLE, 1);
+    ret = wwv_take_pin(wwv_dat, (filp->f_flags & O_NONBLOCK) ? WWV_ADMIT_NONBLOCK : 0);
+    if (ret) goto out;
+    ret = wwv_play_sched(&wwv_dat->eng, sched, ktime_get(), 0);
+    wwv_admit_exit(&wwv_dat->admit);
+
+out:
+    kfree(sched);
+    kfree(rle);
+
+    return ret;
+}
+
+/*
+ * WWV_RING_KICK: the producer has put frames on a ring that was
+ * empty. Only needed on that transition, the worker keeps draining
+ * the ring for as long as it finds frames on it.
+ */
+static long wwv_ring_kick(struct wwv_data_t *wwv_dat)
+{
+    if (wwv_shut_down(wwv_dat)) return -ESHUTDOWN;
+    if (wwv_broadcasting(wwv_dat)) return -EBUSY;
+
+    queue_work(wwv_dat->wq, &wwv_dat->work);
+
+    return 0;
+}
+
+// ioctl system call
+// If another process is using the pins and the device was opened O_NONBLOCK
+//   then return with the appropriate error
+// Otherwise
+//   If another process is using the pins
+//     then block/wait for the pin to be free.  Clean up and return an error if a signal is received.
+//   Otherwise
+//     Copy the user space data using copy_from_user() to a local kernel space buffer that you allocate
+//     Encode to the copied data using your encoding system from homework 5 (your "wwv" code) to another kernel buffer that you allocate
+//     Toggle pins as in homework 04 gpio code.  While delaying, do not consume CPU resources. *** SEE TIMERS-HOWTO.TXT IN THE KERNEL DOCUMENTATION ***
+//       Use a variable for the clock high and low pulse widths that is shared with the ioctl class.  The
+//  CLEAN UP (free all allocated memory and any other resouces you allocated) AND RETURN APPROPRAITE VALUE
+
+// You will need to choose the type of locking yourself.  It may be atmonic variables, spinlocks, mutex, or semaphore.
+static long wwv_ioctl(struct file * filp, unsigned int cmd, unsigned long arg)
+{
+    long ret = 0;					// Return value
+    struct wwv_file *wf;	// Per file data
+    struct wwv_data_t *wwv_dat;	// Driver data - has gpio pins
+    struct tm *udtime = NULL; // Date info passed from user space
+    struct wwv_date *kdtime = NULL; //Seperated date info for wwv functions
+    struct wwv_sched *sched;	// Compiled frame to play
+	
+    // Get our driver data
+    wf=(struct wwv_file *)filp->private_data;
+    wwv_dat=wf->wwv_dat;
+    if (READ_ONCE(wwv_dat->stopping)) return -ENODEV;
+
+    // IOCTL cmds
+    switch (cmd) {
+        case WWV_SUBMIT:
+            return wwv_submit(filp, wwv_dat, arg);
+
+        case WWV_TRANSMIT_BATCH:
+            return wwv_submit_batch(filp, wwv_dat, arg);
+
+        case WWV_STATUS:
+            return wwv_status(wf, arg);
+
+        case WWV_RING_KICK:
+            return wwv_ring_kick(wwv_dat);
+
+        case WWV_ADMIT_STATS:
+            return wwv_admit_stats(wwv_dat, arg);
+
+        case WWV_SET_PROTO:
+            return wwv_set_proto(wwv_dat, (int)arg);
+
+        case WWV_SET_SCALE:
+            return wwv_set_scale(wwv_dat, (int)arg);
+
+        case WWV_TRANSMIT_AT:
+            return wwv_transmit_at(filp, wwv_dat, arg);
+
+        case WWV_CANCEL:
+            return wwv_cancel(wwv_dat, (int)arg);
+
+        case WWV_SUBMIT_URGENT:
+            return wwv_submit_urgent(wwv_dat, arg);
+
+        case WWV_TRANSMIT_RLE:
+            return wwv_transmit_rle(filp, wwv_dat, arg);
+
+        case WWV_BROADCAST:
+            return wwv_set_broadcast(wwv_dat, (int)arg);
+
+	    case WWV_TRANSMIT:
+            // Nothing goes out while Shutdown is asserted, and the
+            // driver owns the pin in broadcast mode
+            if (wwv_shut_down(wwv_dat)) return -ESHUTDOWN;
+            if (wwv_broadcasting(wwv_dat)) return -EBUSY;
+            trace_wwv_submit(wwv_dat->minor, WWV_TR_TRANSMIT, 1);
+
+            // Waits its turn for the pin. Returns error if device is
+            // opened with NONBLOCK while the pins are already being used
+            ret = wwv_take_pin(wwv_dat, (filp->f_flags & O_NONBLOCK) ? WWV_ADMIT_NONBLOCK : 0);
+            if (ret != 0) {
+                pr_debug("Error! Could not acquire lock!\n");
+                return ret;
+            }
+
+            // Allocate memory for userspace data
+            udtime = kmalloc(sizeof(struct tm), GFP_ATOMIC);
+            if (udtime == NULL) {
+                pr_debug("Error! Could not allocate memory for userspace buffer!\n");
+                ret = -ENOMEM;
+                goto fail;
+            }   
+
+            // Allocates memory for the wwv_date struct    
+            kdtime = kmalloc(sizeof(struct wwv_date), GFP_ATOMIC);
+            if (kdtime == NULL) {
+                pr_debug("Error! Could not allocate memory for wwv_date buffer!\n");
+                ret = -ENOMEM;
+                goto fail;
+            } 
+    
+            // Copies date from userspace
+            ret = copy_from_user(udtime, (struct tm *)arg, sizeof(struct tm));
+            if (ret != 0) {
+                pr_debug("Sturct could not be passed\n");
+                ret = -EFAULT;
+                goto fail;
+            }
+
+            // Debuging for userspace
+	        pr_debug("Struct was passed\n");	
+            
+            // Stores date into wwv_date struct
+            ret = wwv_conv_date(udtime, kdtime);
+            if (ret != 0) {
+                pr_debug("Date values passed are not valid!\n");
+                ret = -EINVAL;
+                goto fail;
+            }
+
+            // Prints out Date data for debugging purposes
+            pr_debug("Day: %d Hour: %d Min: %d\n", kdtime->field[WWV_F_YDAY],
+                     kdtime->field[WWV_F_HOUR], kdtime->field[WWV_F_MIN]);
+           
+            // Compiles the frame, then plays it out on the pin
+            sched = wwv_get_sched(wwv_dat, kdtime);
+            if (sched == NULL) {
+                pr_debug("Frame does not fit in the schedule!\n");
+                ret = -EINVAL;
+                goto fail;
+            }
+            ret = wwv_play_sched(&wwv_dat->eng, sched, ktime_get(), 0);
+            if (ret != 0) {
+                pr_debug("Frame was stopped early\n");
+                goto fail;
+            }
+            break;
+		
+        default:
+            pr_debug("Invalid command for wwv\n");
+            ret = -EINVAL;
+            return ret;
+    }
+
+    // Clean up. The pin is left low while it is still ours, once it
+    // is handed on the next frame may already be driving it. A halt
+    // or a destroy since the frame ended already left it low, and the
+    // pin may be on its way back to gpiolib.
+    pr_debug("Clean up\n");
+    spin_lock(&wwv_dat->eng.lock);
+    if (!wwv_dat->eng.halted && !READ_ONCE(wwv_dat->stopping)) wwv_engine_set(&wwv_dat->eng,0);
+    spin_unlock(&wwv_dat->eng.lock);
+    wwv_admit_exit(&wwv_dat->admit);
+    kfree(udtime);
+    udtime = NULL;
+    kfree(kdtime);
+    kdtime = NULL;
+    return 0;
+
+fail:
+    // Unlocks lock
+    wwv_admit_exit(&wwv_dat->admit);
+    
+    // Frees the memory of the buffers (if it needs to)
+    if (udtime != NULL) kfree(udtime);
+    if (kdtime != NULL) kfree(kdtime);
+	
+    return ret;
+}
+
+/*
+ * Drops a record or line of size bytes from the front of the file's
+ * buffer. Only the two bytes that picked the format can be held past
+ * the end of a line, the rest of a line was never taken.
+ */
+static void wwv_wbuf_drop(struct wwv_file *wf, int size)
+{
+    if (size < wf->wlen) {
+        memmove(wf->wbuf, wf->wbuf + size, wf->wlen - size);
+        wf->wlen -= size;
+    } else {
+        wf->wlen = 0;
+    }
+}
+
+/*
+ * Takes the bytes of one record or line from a write() into the
+ * file's buffer, and queues it once it's complete. Bytes of a record
+ * that is not queued are left untaken. A record or line that isn't
+ * valid is dropped with -EINVAL, so the next write() goes on after it.
+ * Returns how many bytes were taken, or an error.
+ */
+static ssize_t wwv_write_one(struct file *filp, struct wwv_file *wf, const char __user *ubuf, size_t len)
+{
+    struct wwv_stamp stamp;
+    struct wwv_date dtime;
+    char *line = wf->wbuf;
+    char *nl;
+    __s16 year;
+    size_t n;
+    int size;
+    int end;
+    int ret;
+
+    if (wf->wmode == WWV_WMODE_NONE) {
+        n = 2 - wf->wlen;
+    } else if (wf->wmode == WWV_WMODE_BINARY) {
+        n = sizeof(struct wwv_stamp) - wf->wlen;
+    } else {
+        n = WWV_LINE_MAX - wf->wlen;
+    }
+    n = min(n, len);
+    if (n && copy_from_user(wf->wbuf + wf->wlen, ubuf, n)) return -EFAULT;
+
+    // Two bytes tell the formats apart, see wwv.h. Read as the year
+    // of a record in the host's byte order, text is never in range.
+    if (wf->wmode == WWV_WMODE_NONE) {
+        wf->wlen += n;
+        if (wf->wlen == 2) {
+            memcpy(&year, wf->wbuf, sizeof(year));
+            wf->wmode = (year >= WWV_STREAM_YEAR_MIN && year <= WWV_STREAM_YEAR_MAX) ?
+                        WWV_WMODE_BINARY : WWV_WMODE_TEXT;
+        }
+        return n;
+    }
+
+    if (wf->wmode == WWV_WMODE_BINARY) {
+        if (wf->wlen + n < sizeof(struct wwv_stamp)) {
+            wf->wlen += n;
+            return n;
+        }
+        memcpy(&stamp, wf->wbuf, sizeof(stamp));
+        size = sizeof(stamp);
+    } else if (wf->wskip) {
+        // Rest of a line that was too long, up to its newline. Nothing
+        // is held in wbuf while skipping.
+        nl = memchr(wf->wbuf, '\n', n);
+        if (nl == NULL) return n;
+        wf->wskip = 0;
+        return nl - wf->wbuf + 1;
+    } else {
+        // The line may end in the bytes that picked the format, so
+        // the whole buffer is searched
+        nl = memchr(wf->wbuf, '\n', wf->wlen + n);
+        if (nl == NULL) {
+            if (wf->wlen + n == WWV_LINE_MAX) {
+                // Too long to be a time. Whatever is written next is
+                // dropped up to the line's newline, so the rest of it
+                // isn't read as a line of its own.
+                wf->wlen = 0;
+                wf->wskip = 1;
+                return -EINVAL;
+            }
+            wf->wlen += n;
+            return n;
+        }
+        size = nl - wf->wbuf + 1;
+        n = size > wf->wlen ? size - wf->wlen : 0;
+
+        // Trim the line, then skip it if it's blank or a comment
+        end = size - 1;
+        while (end > 0 && isspace(line[end - 1])) end--;
+        while (end > 0 && isspace(*line)) {
+            line++;
+            end--;
+        }
+        if (end == 0 || *line == '#') {
+            wwv_wbuf_drop(wf, size);
+            return n;
+        }
+        if (wwv_parse_iso(line, end, &stamp)) {
+            wwv_wbuf_drop(wf, size);
+            return -EINVAL;
+        }
+    }
+
+    if (wwv_conv_stamp(&stamp, &dtime)) {
+        wwv_wbuf_drop(wf, size);
+        return -EINVAL;
+    }
+    ret = wwv_enqueue(filp, wf->wwv_dat, &dtime, 1);
+    if (ret) return ret;
+
+    wwv_wbuf_drop(wf, size);
+    return n;
+}
+
+// Write system call
+// Queues a frame for every record or line written, see wwv.h. With a
+// full queue it waits, or with O_NONBLOCK stops short, so a feeder
+// is held back to the pace the frames go out at.
+static ssize_t wwv_write(struct file *filp, const char __user * buf, size_t count, loff_t * offp)
+{
+    struct wwv_file *wf = filp->private_data;
+    size_t done = 0;
+    ssize_t ret = 0;
+
+    if (READ_ONCE(wf->wwv_dat->stopping)) return -ENODEV;
+    if (mutex_lock_interruptible(&wf->wlock)) return -ERESTARTSYS;
+    while (done < count) {
+        ret = wwv_write_one(filp, wf, buf + done, count - done);
+        if (ret < 0) break;
+        done += ret;
+    }
+    mutex_unlock(&wf->wlock);
+
+    return done ? done : ret;
+}
+
+/*
+ * Frees a channel once the instance and every file open on it have
+ * let go of it.
+ */
+static void wwv_chan_free(struct kref *ref)
+{
+    struct wwv_data_t *wwv_dat = container_of(ref, struct wwv_data_t, ref);
+
+    if (wwv_dat->wq) destroy_workqueue(wwv_dat->wq);
+    hrtimer_cancel(&wwv_dat->eng.timer);
+
+    // Only drops our reference, the page goes with the last mapping
+    if (wwv_dat->ring) free_page((unsigned long)wwv_dat->ring);
+    if (wwv_dat->eng.stats) free_percpu(wwv_dat->eng.stats);
+    vfree(wwv_dat->eng.log);
+
+    kfree(wwv_dat);
+}
+
+// Open system call
+// Open only if the file access flags (NOT permissions) are appropiate as discussed in class
+// Return an appropraite error otherwise
+static int wwv_open(struct inode *inode, struct file *filp)
+{
+    struct wwv_file *wf;
+
+    // SUCESSFULLY THE FILE IF AND ONLY IF THE FILE FLAGS FOR ACCESS ARE APPROPRIATE
+    // RETURN WITH APPROPRIATE ERROR OTHERWISE
+    if ((filp->f_flags&O_ACCMODE)==O_RDONLY) return -EOPNOTSUPP;
+    // O_RDWR is allowed since mmap() of the ring needs read access
+
+    // Per file data points back at the driver data
+    wf=kmalloc(sizeof(struct wwv_file),GFP_KERNEL);
+    if (wf==NULL) return -ENOMEM;
+
+    // The file keeps the channel around until it is closed, even if
+    // the device goes away first
+    mutex_lock(&wwv_idr_lock);
+    wf->wwv_dat=idr_find(&wwv_idr,iminor(inode));
+    if (wf->wwv_dat) kref_get(&wf->wwv_dat->ref);
+    mutex_unlock(&wwv_idr_lock);
+    if (wf->wwv_dat==NULL) {
+        kfree(wf);
+        return -ENODEV;
+    }
+
+    mutex_init(&wf->wlock);
+    wf->wmode=WWV_WMODE_NONE;
+    wf->wlen=0;
+    wf->wskip=0;
+    spin_lock(&wf->wwv_dat->qlock);
+    wf->seen=wf->wwv_dat->completed;
+    spin_unlock(&wf->wwv_dat->qlock);
+
+    filp->private_data=wf;  // My driver data (afsk_dat)
+
+    return 0;
+}
+
+// Close system call
+// Queued frames are left to finish, only the per file data goes. The
+// last file on a destroyed channel frees it.
+static int wwv_release(struct inode *inode, struct file *filp)
+{
+    struct wwv_file *wf = filp->private_data;
+
+    kref_put(&wf->wwv_dat->ref,wwv_chan_free);
+    kfree(wf);
+    filp->private_data=NULL;
+
+    return 0;
+}
+
+/*
+ * mmap() of the shared frame ring. Only one page at offset 0 can be
+ * mapped. The ring is single producer, so only one process should be
+ * feeding it at a time. The mapping holds a reference on the page, so
+ * it outlives the channel if a process still has it mapped.
+ */
+static int wwv_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct wwv_file *wf = filp->private_data;
+    struct wwv_data_t *wwv_dat = wf->wwv_dat;
+    unsigned long size = vma->vm_end - vma->vm_start;
+
+    if (READ_ONCE(wwv_dat->stopping)) return -ENODEV;
+    if (vma->vm_pgoff != 0 || size > PAGE_SIZE) return -EINVAL;
+
+    return vm_insert_page(vma, vma->vm_start, virt_to_page(wwv_dat->ring));
+}
+
+/*
+ * poll() on the device. Writable while the transmit queue has room,
+ * readable once a frame has finished since the last WWV_STATUS on
+ * this file.
+ */
+static __poll_t wwv_poll(struct file *filp, poll_table *wait)
+{
+    struct wwv_file *wf = filp->private_data;
+    struct wwv_data_t *wwv_dat = wf->wwv_dat;
+    __poll_t mask = 0;
+
+    poll_wait(filp, &wwv_dat->pollq, wait);
+    if (READ_ONCE(wwv_dat->stopping)) return EPOLLERR | EPOLLHUP;
+
+    spin_lock(&wwv_dat->qlock);
+    if (wwv_dat->q_head - wwv_dat->q_tail < WWV_QUEUE_LEN) mask |= EPOLLOUT | EPOLLWRNORM;
+    if (wwv_dat->completed != wf->seen) mask |= EPOLLIN | EPOLLRDNORM;
+    spin_unlock(&wwv_dat->qlock);
+
+    return mask;
+}
+
+// File operations for the wwv device
+static const struct file_operations wwv_fops = {
+    .owner = THIS_MODULE,	// Us
+    .open = wwv_open,		// Open
+    .release = wwv_release,// Close
+    .write = wwv_write,	// Write
+    .unlocked_ioctl=wwv_ioctl,	// ioctl
+    .poll = wwv_poll,		// poll/epoll
+    .mmap = wwv_mmap,		// Shared frame ring
+};
+
+// Requests a pin by its GPIO number, as an output set to init_val or
+// as an input if init_val is below 0
+static struct gpio_desc *wwv_request_pin(struct device *dev, int pin, const char *label, int init_val)
+{
+    struct gpio_desc *gpiod_pin=NULL;	// GPIO Descriptor for setting value
+    int ret=-1;	// Return value
+
+    // Verify pin is OK
+    if (!gpio_is_valid(pin)) return NULL;
+
+    // Request the pin - release with devm_gpio_free() by pin number
+    if (init_val>=0) {
+        ret=devm_gpio_request_one(dev,pin,GPIOF_OUT_INIT_LOW,label);
+    } else {
+        ret=devm_gpio_request_one(dev,pin,GPIOF_IN,label);
+    }
+    if (ret<0) {
+        dev_err(dev,"Cannot get %s gpio pin\n",label);
+        return NULL;
+    }
+
+    // Get the gpiod pin struct
+    gpiod_pin=gpio_to_desc(pin);
+    if (gpiod_pin==NULL) {
+        printk(KERN_INFO "Failed to acquire wwv gpio\n");
+        devm_gpio_free(dev,pin);
+        return NULL;
+    }
+
+    // Make sure the pin is set correctly
+    if (init_val>=0) gpiod_set_value(gpiod_pin,init_val);
+
+    return gpiod_pin;
+}
+
+static struct gpio_desc *wwv_dt_obtain_pin(struct device *dev, struct device_node *parent, char *name, int init_val)
+{
+    struct device_node *dn_child=NULL;	// DT child
+    struct gpio_desc *gpiod_pin=NULL;	// GPIO Descriptor for setting value
+    int ret=-1;	// Return value
+    int pin=-1;	// Pin number
+    char *label=NULL;	// DT Pin label
+
+    // Find the child - release with of_node_put()
+    dn_child=of_get_child_by_name(parent,name);
+    if (dn_child==NULL) {
+        printk(KERN_INFO "No child %s\n",name);
+        goto fail;
+    }
+
+    // Get the child pin number - does not appear to need to be released
+    pin=of_get_named_gpio(dn_child,"gpios",0);
+    if (pin<0) {
+        printk(KERN_INFO "no %s GPIOs\n",name);
+        goto fail;
+    }
+    printk(KERN_INFO "Found %s pin %d\n",name,pin);
+
+    // Get the of string tied to pin - Does not appear to need to be released
+    ret=of_property_read_string(dn_child,"label",(const char **)&label);
+    if (ret<0) {
+        printk(KERN_INFO "Cannot find label\n");
+        goto fail;
+    }
+
+    gpiod_pin=wwv_request_pin(dev,pin,label,init_val);
+
+fail:
+    // Release the device node
+    if (dn_child) of_node_put(dn_child);
+
+    return gpiod_pin;
+}
+
+// Gets a pin by its DT child name or, without a DT node, from the
+// platform data. idx is the channel, -1 for the Shutdown input.
+static struct gpio_desc *wwv_obtain_pin(struct device *dev, int idx, int init_val)
+{
+    struct wwv_platform_data *pd=dev_get_platdata(dev);
+    char *name=(char *)(idx<0 ? "Shutdown" : wwv_chan_pins[idx]);
+
+    if (dev->of_node) return wwv_dt_obtain_pin(dev,dev->of_node,name,init_val);
+
+    return wwv_request_pin(dev,idx<0 ? pd->shutdown : pd->pins[idx],name,init_val);
+}
+
+
+// Sets device node permission on the /dev device special file
+static char *wwv_devnode(struct device *dev, umode_t *mode)
+{
+    if (mode) *mode = 0666;
+    return NULL;
+}
+
+/*
+ * Prints one histogram summed over all CPUs. off is the offset of the
+ * histogram inside struct wwv_stats. Each CPU's copy is taken under
+ * its syncp so a tick on that CPU can't tear the u64s on 32-bit.
+ */
+static void wwv_hist_show(struct seq_file *m, struct wwv_data_t *wwv_dat, const char *name, size_t off)
+{
+    struct wwv_hist sum;
+    struct wwv_hist h;
+    struct wwv_stats *st;
+    unsigned int seq;
+    int cpu;
+    int b;
+
+    memset(&sum, 0, sizeof(sum));
+    for_each_possible_cpu(cpu) {
+        st = per_cpu_ptr(wwv_dat->eng.stats, cpu);
+        do {
+            seq = u64_stats_fetch_begin_irq(&st->syncp);
+            memcpy(&h, (char *)st + off, sizeof(h));
+        } while (u64_stats_fetch_retry_irq(&st->syncp, seq));
+
+        if (h.count == 0) continue;
+        if (sum.count == 0 || h.min < sum.min) sum.min = h.min;
+        if (sum.count == 0 || h.max > sum.max) sum.max = h.max;
+        sum.count += h.count;
+        sum.sum += h.sum;
+        for (b = 0; b < WWV_HIST_BUCKETS; b++) {
+            sum.early[b] += h.early[b];
+            sum.late[b] += h.late[b];
+        }
+    }
+
+    seq_printf(m, "%s: count %llu min_ns %lld max_ns %lld mean_ns %lld total_ns %lld\n", name,
+               sum.count, sum.min, sum.max, sum.count ? div64_s64(sum.sum, sum.count) : 0, sum.sum);
+
+    // Early buckets from the largest down, then late ones going up.
+    // Bucket b holds errors of at least 2^(b-1) usecs.
+    for (b = WWV_HIST_BUCKETS - 1; b > 0; b--) {
+        if (sum.early[b]) seq_printf(m, "  <= -%luus %llu\n", 1UL << (b - 1), sum.early[b]);
+    }
+    if (sum.early[0] + sum.late[0]) seq_printf(m, "  < 1us %llu\n", sum.early[0] + sum.late[0]);
+    for (b = 1; b < WWV_HIST_BUCKETS; b++) {
+        if (sum.late[b]) seq_printf(m, "  >= %luus %llu\n", 1UL << (b - 1), sum.late[b]);
+    }
+}
+
+// debugfs lateness: how late each edge was against its scheduled time
+static int wwv_lateness_show(struct seq_file *m, void *v)
+{
+    wwv_hist_show(m, m->private, "lateness", offsetof(struct wwv_stats, late));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wwv_lateness);
+
+// debugfs pulse_width: envelope length error per bit kind
+static int wwv_pulse_width_show(struct seq_file *m, void *v)
+{
+    wwv_hist_show(m, m->private, "zero", offsetof(struct wwv_stats, width[WWV_SYM_ZERO]));
+    wwv_hist_show(m, m->private, "one", offsetof(struct wwv_stats, width[WWV_SYM_ONE]));
+    wwv_hist_show(m, m->private, "marker", offsetof(struct wwv_stats, width[WWV_SYM_MARKER]));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wwv_pulse_width);
+
+// debugfs frame: whole frame length error, and how far each frame
+// ended from the next period
+static int wwv_frame_show(struct seq_file *m, void *v)
+{
+    wwv_hist_show(m, m->private, "frame", offsetof(struct wwv_stats, frame));
+    wwv_hist_show(m, m->private, "slip", offsetof(struct wwv_stats, slip));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wwv_frame);
+
+/*
+ * Clears this CPU's histograms. Runs from on_each_cpu with interrupts
+ * off, so the engine tick can't land on this CPU partway through.
+ */
+static void wwv_reset_cpu(void *info)
+{
+    struct wwv_stats *st = this_cpu_ptr(((struct wwv_data_t *)info)->eng.stats);
+
+    u64_stats_update_begin(&st->syncp);
+    memset(st, 0, offsetof(struct wwv_stats, syncp));
+    u64_stats_update_end(&st->syncp);
+}
+
+// debugfs reset: any write clears all the histograms
+static ssize_t wwv_reset_write(struct file *filp, const char __user *buf, size_t count, loff_t *offp)
+{
+    struct wwv_data_t *wwv_dat = filp->private_data;
+    int cpu;
+
+    // Each online CPU clears its own copy. An offline CPU has no tick
+    // running, so its copy is cleared from here.
+    cpus_read_lock();
+    on_each_cpu(wwv_reset_cpu, wwv_dat, 1);
+    for_each_possible_cpu(cpu) {
+        if (!cpu_online(cpu))
+            memset(per_cpu_ptr(wwv_dat->eng.stats, cpu), 0, offsetof(struct wwv_stats, syncp));
+    }
+    cpus_read_unlock();
+
+    return count;
+}
+
+static const struct file_operations wwv_reset_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = wwv_reset_write,
+};
+
+/*
+ * debugfs edges: drains the edge log as a trace file that wwvdec
+ * reads. The header comes first on each open, then every edge logged
+ * since the last read, with CLOCK_MONOTONIC times. Reads never block,
+ * an empty log reads as the end of the file.
+ */
+static ssize_t wwv_edges_read(struct file *filp, char __user *buf, size_t count, loff_t *offp)
+{
+    struct wwv_engine *eng = &((struct wwv_data_t *)filp->private_data)->eng;
+    u32 version = WWV_TRACE_VERSION;
+    size_t done = 0;
+    ssize_t ret = 0;
+    u32 head;
+    u32 tail;
+
+    mutex_lock(&eng->log_read);
+    if (*offp == 0) {
+        if (count < 8) {
+            ret = -EINVAL;
+            goto out;
+        }
+        if (copy_to_user(buf, WWV_TRACE_MAGIC, 4) || copy_to_user(buf + 4, &version, 4)) {
+            ret = -EFAULT;
+            goto out;
+        }
+        done = 8;
+    }
+
+    // Pairs with the timer's store of log_head after it fills an entry
+    tail = eng->log_tail;
+    head = smp_load_acquire(&eng->log_head);
+    while (tail != head && count - done >= sizeof(struct wwv_edge)) {
+        if (copy_to_user(buf + done, &eng->log[tail & (eng->log_len - 1)], sizeof(struct wwv_edge))) {
+            ret = -EFAULT;
+            break;
+        }
+        done += sizeof(struct wwv_edge);
+        tail++;
+    }
+    smp_store_release(&eng->log_tail, tail);
+
+out:
+    mutex_unlock(&eng->log_read);
+    *offp += done;
+
+    return done ? done : ret;
+}
+
+static const struct file_operations wwv_edges_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .read = wwv_edges_read,
+};
+
+/*
+ * Creates a channel's debugfs files for the timing stats. debugfs is
+ * optional, so failures here are not fatal.
+ */
+static void wwv_debugfs_init(struct wwv_data_t *wwv_dat)
+{
+    char name[16];
+
+    if (wwv_debugfs == NULL) return;
+
+    snprintf(name, sizeof(name), "wwv%d", wwv_dat->minor);
+    wwv_dat->debugfs = debugfs_create_dir(name, wwv_debugfs);
+    if (IS_ERR_OR_NULL(wwv_dat->debugfs)) {
+        wwv_dat->debugfs = NULL;
+        return;
+    }
+
+    debugfs_create_file("lateness", 0444, wwv_dat->debugfs, wwv_dat, &wwv_lateness_fops);
+    debugfs_create_file("pulse_width", 0444, wwv_dat->debugfs, wwv_dat, &wwv_pulse_width_fops);
+    debugfs_create_file("frame", 0444, wwv_dat->debugfs, wwv_dat, &wwv_frame_fops);
+    debugfs_create_file("reset", 0200, wwv_dat->debugfs, wwv_dat, &wwv_reset_fops);
+    if (wwv_dat->eng.log) {
+        debugfs_create_file("edges", 0400, wwv_dat->debugfs, wwv_dat, &wwv_edges_fops);
+        debugfs_create_u32("edges_dropped", 0444, wwv_dat->debugfs, &wwv_dat->eng.log_dropped);
+    }
+}
+
+// sysfs broadcast attribute, 1 while in free running broadcast mode
+static ssize_t broadcast_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%d\n", wwv_broadcasting(wwv_dat));
+}
+
+static ssize_t broadcast_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+    int on;
+    int ret;
+
+    ret = kstrtoint(buf, 0, &on);
+    if (ret) return ret;
+
+    ret = wwv_set_broadcast(wwv_dat, on);
+    if (ret) return ret;
+
+    return count;
+}
+static DEVICE_ATTR_RW(broadcast);
+
+// sysfs admit_timeout_ms attribute, bound on a WWV_TRANSMIT wait, 0 for none
+static ssize_t admit_timeout_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", READ_ONCE(wwv_dat->admit.timeout_ms));
+}
+
+static ssize_t admit_timeout_ms_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+    unsigned int ms;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &ms);
+    if (ret) return ret;
+
+    // Only read when a waiter joins the queue
+    WRITE_ONCE(wwv_dat->admit.timeout_ms, ms);
+
+    return count;
+}
+static DEVICE_ATTR_RW(admit_timeout_ms);
+
+// sysfs protocol attribute, the name of the channel's timecode format
+static ssize_t protocol_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%s\n", READ_ONCE(wwv_dat->proto)->name);
+}
+
+static ssize_t protocol_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+    const struct wwv_proto *proto;
+    int id;
+
+    for (id = 0; (proto = wwv_proto_get(id)) != NULL; id++) {
+        if (sysfs_streq(buf, proto->name)) {
+            wwv_set_proto(wwv_dat, id);
+            return count;
+        }
+    }
+
+    return -EINVAL;
+}
+static DEVICE_ATTR_RW(protocol);
+
+// sysfs timescale attribute, how many times faster than real time frames go out
+static ssize_t timescale_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", READ_ONCE(wwv_dat->eng.scale));
+}
+
+static ssize_t timescale_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+    int scale;
+    int ret;
+
+    ret = kstrtoint(buf, 0, &scale);
+    if (ret) return ret;
+
+    ret = wwv_set_scale(wwv_dat, scale);
+    if (ret) return ret;
+
+    return count;
+}
+static DEVICE_ATTR_RW(timescale);
+
+// sysfs pin_backend attribute, how the engine sets the pin
+static ssize_t pin_backend_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%s\n", wwv_engine_backend(&wwv_dat->eng));
+}
+static DEVICE_ATTR_RO(pin_backend);
+
+// sysfs shutdown attribute, 1 while the Shutdown input holds the pin low
+static ssize_t shutdown_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct wwv_data_t *wwv_dat = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%d\n", wwv_shut_down(wwv_dat));
+}
+static DEVICE_ATTR_RO(shutdown);
+
+static struct attribute *wwv_attrs[] = {
+    &dev_attr_broadcast.attr,
+    &dev_attr_admit_timeout_ms.attr,
+    &dev_attr_protocol.attr,
+    &dev_attr_timescale.attr,
+    &dev_attr_pin_backend.attr,
+    &dev_attr_shutdown.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(wwv);
+
+/*
+ * Stops a channel and drops the instance's hold on it. Queued frames
+ * are dropped, broadcast mode is turned off and the frame on the pin
+ * is stopped, then the engine is halted so nothing reaches the pin
+ * again. Files still open on the channel get -ENODEV from here on,
+ * and the last one to close frees it. The pin itself belongs to the
+ * instance and is left alone.
+ */
+static void wwv_chan_destroy(struct wwv_data_t *wwv_dat)
+{
+    // Take the device away first so nothing new is opened
+    mutex_lock(&wwv_idr_lock);
+    if (wwv_dat->minor>=0) idr_remove(&wwv_idr,wwv_dat->minor);
+    mutex_unlock(&wwv_idr_lock);
+    if (wwv_dat->wwv_dev) device_destroy(wwv_class,MKDEV(MAJOR(wwv_devt),wwv_dat->minor));
+    if (wwv_dat->cdev) cdev_del(wwv_dat->cdev);
+
+    spin_lock(&wwv_dat->qlock);
+    wwv_dat->broadcast=0;
+    WRITE_ONCE(wwv_dat->stopping,1);
+    wwv_dat->q_tail=wwv_dat->q_head;
+    spin_unlock(&wwv_dat->qlock);
+    wake_up_interruptible(&wwv_dat->pollq);
+
+    // Stop the frame on the pin rather than wait out the rest of it,
+    // and let the worker see it's done before the pin is given back
+    wwv_engine_abort(&wwv_dat->eng);
+    if (wwv_dat->wq) flush_workqueue(wwv_dat->wq);
+    wwv_engine_halt(&wwv_dat->eng,1);
+    flush_work(&wwv_dat->eng.pin_work);
+    debugfs_remove_recursive(wwv_dat->debugfs);
+
+    kref_put(&wwv_dat->ref,wwv_chan_free);
+}
+
+/*
+ * Sets up a transmit channel on a pin with its own lock, queue,
+ * engine, worker and /dev/wwvN. regs is the instance's mapped GPIO
+ * block, or NULL to go through gpiolib. Returns the channel or an
+ * ERR_PTR.
+ */
+static struct wwv_data_t *wwv_chan_create(struct device *dev, struct gpio_desc *pin, void __iomem *regs)
+{
+    struct wwv_data_t *wwv_dat;
+    dev_t devt;
+    int cpu;
+    int ret;
+
+    wwv_dat=kzalloc(sizeof(struct wwv_data_t),GFP_KERNEL);
+    if (wwv_dat==NULL) return ERR_PTR(-ENOMEM);
+    kref_init(&wwv_dat->ref);
+
+    wwv_dat->gpio_wwv=pin;
+    wwv_dat->proto=wwv_proto_get(WWV_PROTO_ECE331);
+    wwv_admit_init(&wwv_dat->admit);
+    wwv_engine_init(&wwv_dat->eng, pin, regs);
+    spin_lock_init(&wwv_dat->qlock);
+    init_waitqueue_head(&wwv_dat->pollq);
+    INIT_WORK(&wwv_dat->work, wwv_tx_work);
+    INIT_WORK(&wwv_dat->bcast_work, wwv_bcast_work);
+
+    // Pick the lowest free minor
+    mutex_lock(&wwv_idr_lock);
+    wwv_dat->minor=idr_alloc(&wwv_idr,wwv_dat,0,WWV_MINORS,GFP_KERNEL);
+    mutex_unlock(&wwv_idr_lock);
+    if (wwv_dat->minor<0) {
+        printk(KERN_INFO "No free minor numbers\n");
+        ret=wwv_dat->minor;
+        goto fail;
+    }
+    devt=MKDEV(MAJOR(wwv_devt),wwv_dat->minor);
+    wwv_dat->admit.minor=wwv_dat->minor;
+    wwv_dat->eng.minor=wwv_dat->minor;
+
+    // Timing stats
+    wwv_dat->eng.stats=alloc_percpu(struct wwv_stats);
+    if (wwv_dat->eng.stats==NULL) {
+        printk(KERN_INFO "Failed to allocate stats\n");
+        ret=-ENOMEM;
+        goto fail;
+    }
+    for_each_possible_cpu(cpu) u64_stats_init(&per_cpu_ptr(wwv_dat->eng.stats,cpu)->syncp);
+    if (edge_log) {
+        wwv_dat->eng.log_len=roundup_pow_of_two(edge_log);
+        wwv_dat->eng.log=vzalloc(array_size(wwv_dat->eng.log_len,sizeof(struct wwv_edge)));
+        if (wwv_dat->eng.log==NULL) {
+            printk(KERN_INFO "Failed to allocate edge log\n");
+            ret=-ENOMEM;
+            goto fail;
+        }
+    }
+    wwv_debugfs_init(wwv_dat);
+
+    // Shared frame ring and the worker that drains the queue
+    BUILD_BUG_ON(sizeof(struct wwv_ring) > PAGE_SIZE);
+    wwv_dat->ring=(struct wwv_ring *)get_zeroed_page(GFP_KERNEL);
+    if (wwv_dat->ring==NULL) {
+        printk(KERN_INFO "Failed to allocate ring\n");
+        ret=-ENOMEM;
+        goto fail;
+    }
+    wwv_dat->ring->slots=WWV_RING_SLOTS;
+    wwv_dat->wq=alloc_ordered_workqueue("wwv%d",0,wwv_dat->minor);
+    if (wwv_dat->wq==NULL) {
+        printk(KERN_INFO "Failed to create workqueue\n");
+        ret=-ENOMEM;
+        goto fail;
+    }
+
+    // Character device, live as soon as it's added. It's allocated on
+    // its own since open files hold it past the channel's destroy.
+    wwv_dat->cdev=cdev_alloc();
+    if (wwv_dat->cdev==NULL) {
+        printk(KERN_INFO "Failed to allocate character device\n");
+        ret=-ENOMEM;
+        goto fail;
+    }
+    wwv_dat->cdev->ops=&wwv_fops;
+    wwv_dat->cdev->owner=THIS_MODULE;
+    ret=cdev_add(wwv_dat->cdev,devt,1);
+    if (ret<0) {
+        printk(KERN_INFO "Failed to add character device\n");
+        goto fail;
+    }
+
+    // Device special file /dev/wwvN with 0666 perms
+    wwv_dat->wwv_dev=device_create_with_groups(wwv_class,dev,devt,(void *)wwv_dat,wwv_groups,"wwv%d",wwv_dat->minor);
+    if (IS_ERR(wwv_dat->wwv_dev)) {
+        printk(KERN_INFO "Failed to create device file\n");
+        ret=PTR_ERR(wwv_dat->wwv_dev);
+        wwv_dat->wwv_dev=NULL;
+        goto fail;
+    }
+
+    return wwv_dat;
+
+fail:
+    wwv_chan_destroy(wwv_dat);
+    return ERR_PTR(ret);
+}
+
+/*
+ * Maps the GPIO register block in the DT node's reg for the mmio pin
+ * backend. Returns NULL to use gpiolib, or an ERR_PTR if mmio was
+ * asked for and can't be had.
+ */
+static void __iomem *wwv_map_regs(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;
+    struct resource *res;
+    void __iomem *regs;
+
+    if (sysfs_streq(pin_backend, "gpiod")) return NULL;
+    if (!sysfs_streq(pin_backend, "auto") && !sysfs_streq(pin_backend, "mmio")) {
+        dev_err(dev, "Unknown pin_backend %s\n", pin_backend);
+        return ERR_PTR(-EINVAL);
+    }
+
+    res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+    if (res == NULL || resource_size(res) < WWV_GPIO_REGS) {
+        if (sysfs_streq(pin_backend, "auto")) return NULL;
+        dev_err(dev, "No GPIO registers in the DT node\n");
+        return ERR_PTR(-ENODEV);
+    }
+
+    // The block belongs to the pinctrl driver, so it is mapped
+    // without claiming the region
+    regs = devm_ioremap(dev, res->start, resource_size(res));
+    if (regs == NULL) return ERR_PTR(-ENOMEM);
+
+    return regs;
+}
+
+/*
+ * Picks the registers a pin's engine writes: regs if the pin's
+ * gpio_chip is the bank of the pinctrl node whose reg was mapped,
+ * NULL to go through gpiolib. On any other chip, e.g. an expander,
+ * the offset would set a BCM283x pin instead, so "mmio" fails the
+ * probe for it.
+ */
+static void __iomem *wwv_pin_regs(struct platform_device *pdev, struct gpio_desc *pin, void __iomem *regs)
+{
+    struct gpio_chip *chip = gpiod_to_chip(pin);
+    struct resource *res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+    struct resource chip_res;
+
+    if (regs == NULL) return NULL;
+
+    if (chip != NULL && chip->of_node != NULL &&
+        of_address_to_resource(chip->of_node, 0, &chip_res) == 0 && chip_res.start == res->start)
+        return regs;
+
+    if (sysfs_streq(pin_backend, "auto")) return NULL;
+    dev_err(&pdev->dev, "Pin on %s is not in the GPIO registers of the DT node\n",
+            chip != NULL ? chip->label : "no chip");
+    return ERR_PTR(-ENODEV);
+}
+
+/*
+ * Reads the Shutdown input and passes a change on to every channel.
+ * Called from the IRQ thread, and once at probe.
+ */
+static void wwv_shutdown_update(struct wwv_inst *inst)
+{
+    int on;
+    int i;
+
+    mutex_lock(&inst->shutdown_lock);
+    on = gpiod_get_value_cansleep(inst->gpio_shutdown) > 0;
+    if (on != inst->shutdown) {
+        inst->shutdown = on;
+        for (i=0;i<inst->nchan;i++) wwv_chan_shutdown(inst->chan[i],on);
+        printk(KERN_INFO "Shutdown %s\n", on ? "asserted, output held low" : "released");
+    }
+    mutex_unlock(&inst->shutdown_lock);
+}
+
+// Threaded handler for either edge of Shutdown
+static irqreturn_t wwv_shutdown_irq(int irq, void *data)
+{
+    wwv_shutdown_update(data);
+
+    return IRQ_HANDLED;
+}
+
+/*
+ * Tears down every channel of an instance and gives back its pins.
+ */
+static void wwv_inst_free(struct device *dev, struct wwv_inst *inst)
+{
+    struct gpio_desc *pin;
+    int i;
+
+    // The handler walks the channels, so it goes before them
+    if (inst->shutdown_irq>0) free_irq(inst->shutdown_irq,inst);
+
+    for (i=inst->nchan-1;i>=0;i--) {
+        pin=inst->chan[i]->gpio_wwv;
+        wwv_chan_destroy(inst->chan[i]);
+        devm_gpio_free(dev,desc_to_gpio(pin));
+    }
+    if (inst->gpio_shutdown) devm_gpio_free(dev,desc_to_gpio(inst->gpio_shutdown));
+#if 0
+    // not clear if these are allocated and need to be freed
+    gpiod_put(inst->gpio_shutdown);
+#endif
+
+    dev_set_drvdata(dev,NULL);
+    kfree(inst);
+}
+
+// My data is going to go in either platform_data or driver_data
+//  within &pdev->dev. (dev_set/get_drvdata)
+// Called when the device is "found" - for us
+// This is called on module load based on ".of_match_table" member
+// Each output pin in the DT node, or in the platform data, becomes its own channel
+static int wwv_probe(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;	// Device associcated with platform
+
+    struct wwv_inst *inst;		// Channels of this instance
+    struct wwv_data_t *wwv_dat;		// Data to be passed around the calls
+    struct gpio_desc *pin;
+    void __iomem *regs;			// GPIO registers, NULL for gpiolib
+    void __iomem *pin_regs;		// regs if they hold the pin, else NULL
+
+    int ret=-1;	// Return value
+    int i;
+
+
+    // Allocate device driver data and save
+    inst=kzalloc(sizeof(struct wwv_inst),GFP_KERNEL);
+    if (inst==NULL) {
+        printk(KERN_INFO "Memory allocation failed\n");
+        return -ENOMEM;
+    }
+	
+    mutex_init(&inst->shutdown_lock);
+    dev_set_drvdata(dev,inst);
+
+    // Pins come from the DT node, or from platform data (wwv_sim)
+    BUILD_BUG_ON(WWV_CHANS!=WWV_PDATA_PINS);
+    if (dev->of_node==NULL && dev_get_platdata(dev)==NULL) {
+        printk(KERN_INFO "Cannot find device\n");
+        ret=-ENODEV;
+        goto fail;
+    }
+    inst->gpio_shutdown=wwv_obtain_pin(dev,-1,-1);
+    if (inst->gpio_shutdown==NULL) {
+        ret=-ENODEV;
+        goto fail;
+    }
+
+    regs=wwv_map_regs(pdev);
+    if (IS_ERR(regs)) {
+        ret=PTR_ERR(regs);
+        goto fail;
+    }
+
+    for (i=0;i<WWV_CHANS;i++) {
+        pin=wwv_obtain_pin(dev,i,0);
+        if (pin==NULL) {
+            ret=-ENODEV;
+            goto fail;
+        }
+
+        pin_regs=wwv_pin_regs(pdev,pin,regs);
+        wwv_dat=IS_ERR(pin_regs) ? ERR_CAST(pin_regs) : wwv_chan_create(dev,pin,pin_regs);
+        if (IS_ERR(wwv_dat)) {
+            devm_gpio_free(dev,desc_to_gpio(pin));
+            ret=PTR_ERR(wwv_dat);
+            goto fail;
+        }
+        inst->chan[inst->nchan++]=wwv_dat;
+        dev_info(dev,"%s on wwv%d through %s\n",wwv_chan_pins[i],wwv_dat->minor,
+                 wwv_engine_backend(&wwv_dat->eng));
+    }
+
+    // Shutdown is taken on both edges. The level is read in the
+    // handler, so a bounce settles on whatever the pin ends up at.
+    ret=gpiod_to_irq(inst->gpio_shutdown);
+    if (ret>0 && request_threaded_irq(ret,NULL,wwv_shutdown_irq,
+                                      IRQF_TRIGGER_RISING|IRQF_TRIGGER_FALLING|IRQF_ONESHOT,
+                                      "wwv-shutdown",inst)==0) {
+        inst->shutdown_irq=ret;
+    } else {
+        dev_warn(dev,"No IRQ for Shutdown, it is only read at probe\n");
+    }
+    wwv_shutdown_update(inst);
+	
+    printk(KERN_INFO "Registered\n");
+    dev_info(dev, "Initialized");
+    return 0;
+
+fail:
+    wwv_inst_free(dev,inst);
+    printk(KERN_INFO "WWV Failed\n");
+    return ret;
+}
+
+// Called when the device is removed or the module is removed
+static int wwv_remove(struct platform_device *pdev)
+{
+    struct device *dev = &pdev->dev;
+
+    // Stop every channel and free the pins
+    wwv_inst_free(dev,dev_get_drvdata(dev));
+
+    printk(KERN_INFO "Removed\n");
+    dev_info(dev, "GPIO mem driver removed - OK");
+
+    return 0;
+}
+static const struct of_device_id wwv_of_match[] = {
+    {.compatible = "brcm,bcm2835-wwv",},
+    { /* sentinel */ },
+};
+
+MODULE_DEVICE_TABLE(of, wwv_of_match);
+
+static struct platform_driver wwv_driver = {
+    .probe = wwv_probe,
+    .remove = wwv_remove,
+    .driver = {
+            .name = "bcm2835-wwv",
+            .owner = THIS_MODULE,
+            .of_match_table = wwv_of_match,
+            },
+};
+
+/*
+ * Module load. The device numbers, class and debugfs directory are
+ * shared by every instance, so they are set up before the driver is
+ * registered and any probe runs.
+ */
+static int __init wwv_init(void)
+{
+    int ret;
+
+    // Automagically assign a major number with room for every channel
+    ret=alloc_chrdev_region(&wwv_devt,0,WWV_MINORS,"wwv");
+    if (ret<0) {
+        printk(KERN_INFO "Failed to register character device\n");
+        return ret;
+    }
+
+    // Create a class instance
+    wwv_class=class_create(THIS_MODULE, "wwv_class");
+    if (IS_ERR(wwv_class)) {
+        printk(KERN_INFO "Failed to create class\n");
+        ret=PTR_ERR(wwv_class);
+        goto fail;
+    }
+    // Setup the device so the device special file is created with 0666 perms
+    wwv_class->devnode=wwv_devnode;
+
+    // debugfs is optional
+    wwv_debugfs=debugfs_create_dir("wwv",NULL);
+    if (IS_ERR_OR_NULL(wwv_debugfs)) wwv_debugfs=NULL;
+
+    ret=platform_driver_register(&wwv_driver);
+    if (ret<0) goto fail;
+
+    return 0;
+
+fail:
+    debugfs_remove_recursive(wwv_debugfs);
+    if (!IS_ERR_OR_NULL(wwv_class)) class_destroy(wwv_class);
+    unregister_chrdev_region(wwv_devt,WWV_MINORS);
+    return ret;
+}
+
+// Module unload, the driver goes first so every channel is gone
+static void __exit wwv_exit(void)
+{
+    platform_driver_unregister(&wwv_driver);
+    debugfs_remove_recursive(wwv_debugfs);
+    class_destroy(wwv_class);
+    unregister_chrdev_region(wwv_devt,WWV_MINORS);
+    idr_destroy(&wwv_idr);
+}
+
+module_init(wwv_init);
+module_exit(wwv_exit);
+
+MODULE_DESCRIPTION("WWV pin modulator");
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("WWV");
+//MODULE_ALIAS("platform:wwv-bcm2835");
@@ -0,0 +1,730 @@
+// Encoder core for the WWV time/date transmitter
+// Turns a date into a schedule of pin levels and walks it edge by edge.
+
+/*
+ * Eric Sullivan
+ * Split out of the driver so it can be built as a userspace library
+ * and tested without a Raspberry Pi.
+ */
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#else
+#include <string.h>
+#define div_u64(a, b) ((a) / (b))
+#endif
+
+#include "wwv.h"
+#include "wwv_enc.h"
+
+//************************************
+// WWV Data format, as the ECE331 expansion board decodes it. The NIST
+// WWV format fills in the blanks: 45-48 are zeros, 49 and 59 are
+// markers, 50 is the DUT1 sign, 51-54 the year tens, 55 DST1 and 56-58
+// the size of DUT1.
+//         0        1       2          3             4          5           6          7           8       9
+// +----+-------+-------+-------+---------------+-----------------------------------------------+-------+-------+
+// |P0	|		|		|		|				|		YEAR Units Value BCD LSb First 			|		|		|
+// |	|		|		|		|				+-----------+-----------+-----------+-----------+		|		|
+// |	|Blank	|Zero	|DST	|Leap Sec Warn	|1's Year	|2's Year	|4's Year	|8's Year	|Zero	|POS ID	|
+// +----+-------+-------+-------+---------------+-----------+-----------+-----------+-----------+-------+-------+
+//          10          11          12          13        14        15                16            17             18      19
+// +----+-----------------------------------------------+-------+-----------------------------------------------+-------+-------+
+// |P1	|	 Minute Units Value BCD LSb First			|		|			Minute Tens Value BCD LSb First 	|		|		|
+// |	+-----------+-----------+-----------+-----------+		+---------------+---------------+---------------+		|		|
+// |	|1's Minute	|2's Minute	|4's Minute	|8's Minute	|Zero	|10's Minute	|20's Minute	|40's Minute	|Zero	|POS ID	|
+// +----+-----------+-----------+-----------+-----------+-------+---------------+---------------+---------------+-------+-------+
+//          20           21          22         23         24          25            26               27           28      29
+// +----+-----------------------------------------------+-------+-----------------------------------------------+-------+-------+
+// |P2	|		 Hour Units Value BCD LSb First			|		|			Hour Tens Value BCD LSb First	 	|		|		|
+// |	+-----------+-----------+-----------+-----------+		+---------------+---------------+---------------+		|		|
+// |	|1's Hour	|2's Hour	|4's Hour	|8's Hour	|Zero	|10's Hour		|20's Hour		|40's Hour		|Zero	|POS ID	|
+// +----+-----------+-----------+-----------+-----------+-------+---------------+---------------+---------------+-------+-------+
+//             30                   31                 32                  33              34          35                  36                  37                38                39
+// +----+-------------------------------------------------------------------------------+-------+-------------------------------------------------------------------------------+-------+
+// |P3	|				 Day of Year Units Value BCD LSb First							|		|					Day of Year Tens Value BCD LSb First						|		|
+// +    +-------------------+-------------------+-------------------+-------------------+       +-------------------+-------------------+-------------------+-------------------+       +
+// |	|1's Day of Year	|2's Day of Year	|4's Day of Year	|8's Day of Year	|Zero	|10's Day of Year	|20's Day of Year	|40's Day of Year	|80's Day of Year	|POS ID	|
+// +----+-------------------+-------------------+-------------------+-------------------+-------+-------------------+-------------------+-------------------+-------------------+-------+
+//              40                     41                  42      43       44     45      46       47     48      49
+// +----+-----------------------------------------------+-------+-------+-------+-------+-------+-------+-------+-------+
+// |P4	|	 Day of Year Hundreds Value BCD LSb First	|		|		|		|		|		|		|		|		|
+// |	+-----------+-----------+-----------+-----------+		|		|		|		|		|		|		|		|
+// |	|100's Day of Year		|200's Day of Year		|Zero	|Zero	|Zero	|Blank	|Blank	|Blank	|Blank	|Blank	|
+// +----+-----------------------+-----------------------+-------+-------+-------+-------+-------+-------+-------+-------+
+//        50       51      52     53       54      55      56     57       58      59
+// +----+-------+-------+-------+-------+-------+-------+-------+-------+-------+-------+
+// |P5	|Blank	|Blank	|Blank	|Blank	|Blank	|Blank	|Blank	|Blank	|Blank  |Blank  |
+// +----+-------+-------+-------+-------+-------+-------+-------+-------+-------+-------+
+
+// Slot table shorthand
+#define S_BLANK { WWV_SLOT_BLANK, 0, 0 }
+#define S_ZERO { WWV_SLOT_ZERO, 0, 0 }
+#define S_ONE { WWV_SLOT_ONE, 0, 0 }
+#define S_MARK { WWV_SLOT_MARKER, 0, 0 }
+#define S_BIT(f, b) { WWV_SLOT_FIELD, WWV_F_##f, b }
+#define S_PAR(first, n) { WWV_SLOT_PARITY, first, n }
+#define S_BIN(f, b) { WWV_SLOT_BINARY, WWV_F_##f, b }
+
+// The frame the ECE331 expansion board decodes, see the diagram above.
+// Year units only, and nothing after second 44.
+static const struct wwv_slot wwv_slots_ece331[60] = {
+    S_BLANK, S_ZERO, S_BIT(DST2, 0), S_BIT(LSW, 0),
+    S_BIT(YEAR, 0), S_BIT(YEAR, 1), S_BIT(YEAR, 2), S_BIT(YEAR, 3), S_ZERO, S_MARK,
+    S_BIT(MIN, 0), S_BIT(MIN, 1), S_BIT(MIN, 2), S_BIT(MIN, 3), S_ZERO,
+    S_BIT(MIN, 4), S_BIT(MIN, 5), S_BIT(MIN, 6), S_ZERO, S_MARK,
+    S_BIT(HOUR, 0), S_BIT(HOUR, 1), S_BIT(HOUR, 2), S_BIT(HOUR, 3), S_ZERO,
+    S_BIT(HOUR, 4), S_BIT(HOUR, 5), S_BIT(HOUR, 6), S_ZERO, S_MARK,
+    S_BIT(YDAY, 0), S_BIT(YDAY, 1), S_BIT(YDAY, 2), S_BIT(YDAY, 3), S_ZERO,
+    S_BIT(YDAY, 4), S_BIT(YDAY, 5), S_BIT(YDAY, 6), S_BIT(YDAY, 7), S_MARK,
+    S_BIT(YDAY, 8), S_BIT(YDAY, 9), S_ZERO, S_ZERO, S_ZERO,
+    S_BLANK, S_BLANK, S_BLANK, S_BLANK, S_BLANK,
+    S_BLANK, S_BLANK, S_BLANK, S_BLANK, S_BLANK,
+    S_BLANK, S_BLANK, S_BLANK, S_BLANK, S_BLANK,
+};
+
+// NIST WWV/WWVH. Second 0 has no pulse.
+static const struct wwv_slot wwv_slots_wwv[60] = {
+    S_BLANK, S_ZERO, S_BIT(DST2, 0), S_BIT(LSW, 0),
+    S_BIT(YEAR, 0), S_BIT(YEAR, 1), S_BIT(YEAR, 2), S_BIT(YEAR, 3), S_ZERO, S_MARK,
+    S_BIT(MIN, 0), S_BIT(MIN, 1), S_BIT(MIN, 2), S_BIT(MIN, 3), S_ZERO,
+    S_BIT(MIN, 4), S_BIT(MIN, 5), S_BIT(MIN, 6), S_ZERO, S_MARK,
+    S_BIT(HOUR, 0), S_BIT(HOUR, 1), S_BIT(HOUR, 2), S_BIT(HOUR, 3), S_ZERO,
+    S_BIT(HOUR, 4), S_BIT(HOUR, 5), S_ZERO, S_ZERO, S_MARK,
+    S_BIT(YDAY, 0), S_BIT(YDAY, 1), S_BIT(YDAY, 2), S_BIT(YDAY, 3), S_ZERO,
+    S_BIT(YDAY, 4), S_BIT(YDAY, 5), S_BIT(YDAY, 6), S_BIT(YDAY, 7), S_MARK,
+    S_BIT(YDAY, 8), S_BIT(YDAY, 9), S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_MARK,
+    S_BIT(DUT1_POS, 0), S_BIT(YEAR, 4), S_BIT(YEAR, 5), S_BIT(YEAR, 6), S_BIT(YEAR, 7),
+    S_BIT(DST1, 0), S_BIT(DUT1, 0), S_BIT(DUT1, 1), S_BIT(DUT1, 2), S_MARK,
+};
+
+// NIST WWVB amplitude code, most significant bit first. Markers at 59
+// and 0 mark the start of the minute.
+static const struct wwv_slot wwv_slots_wwvb[60] = {
+    S_MARK, S_BIT(MIN, 6), S_BIT(MIN, 5), S_BIT(MIN, 4), S_ZERO,
+    S_BIT(MIN, 3), S_BIT(MIN, 2), S_BIT(MIN, 1), S_BIT(MIN, 0), S_MARK,
+    S_ZERO, S_ZERO, S_BIT(HOUR, 5), S_BIT(HOUR, 4), S_ZERO,
+    S_BIT(HOUR, 3), S_BIT(HOUR, 2), S_BIT(HOUR, 1), S_BIT(HOUR, 0), S_MARK,
+    S_ZERO, S_ZERO, S_BIT(YDAY, 9), S_BIT(YDAY, 8), S_ZERO,
+    S_BIT(YDAY, 7), S_BIT(YDAY, 6), S_BIT(YDAY, 5), S_BIT(YDAY, 4), S_MARK,
+    S_BIT(YDAY, 3), S_BIT(YDAY, 2), S_BIT(YDAY, 1), S_BIT(YDAY, 0), S_ZERO,
+    S_ZERO, S_BIT(DUT1_POS, 0), S_BIT(DUT1_NEG, 0), S_BIT(DUT1_POS, 0), S_MARK,
+    S_BIT(DUT1, 3), S_BIT(DUT1, 2), S_BIT(DUT1, 1), S_BIT(DUT1, 0), S_ZERO,
+    S_BIT(YEAR, 7), S_BIT(YEAR, 6), S_BIT(YEAR, 5), S_BIT(YEAR, 4), S_MARK,
+    S_BIT(YEAR, 3), S_BIT(YEAR, 2), S_BIT(YEAR, 1), S_BIT(YEAR, 0), S_ZERO,
+    S_BIT(LYI, 0), S_BIT(LSW, 0), S_BIT(DST1, 0), S_BIT(DST2, 0), S_MARK,
+};
+
+// DCF77, least significant bit first with even parity. There are no
+// markers, second 59 has no pulse instead.
+static const struct wwv_slot wwv_slots_dcf77[60] = {
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_BIT(DST1, 0), S_BIT(STD, 0), S_BIT(LSW, 0),
+    S_ONE, S_BIT(MIN, 0), S_BIT(MIN, 1), S_BIT(MIN, 2), S_BIT(MIN, 3),
+    S_BIT(MIN, 4), S_BIT(MIN, 5), S_BIT(MIN, 6), S_PAR(21, 7), S_BIT(HOUR, 0),
+    S_BIT(HOUR, 1), S_BIT(HOUR, 2), S_BIT(HOUR, 3), S_BIT(HOUR, 4), S_BIT(HOUR, 5),
+    S_PAR(29, 6), S_BIT(MDAY, 0), S_BIT(MDAY, 1), S_BIT(MDAY, 2), S_BIT(MDAY, 3),
+    S_BIT(MDAY, 4), S_BIT(MDAY, 5), S_BIT(WDAY, 0), S_BIT(WDAY, 1), S_BIT(WDAY, 2),
+    S_BIT(MON, 0), S_BIT(MON, 1), S_BIT(MON, 2), S_BIT(MON, 3), S_BIT(MON, 4),
+    S_BIT(YEAR, 0), S_BIT(YEAR, 1), S_BIT(YEAR, 2), S_BIT(YEAR, 3), S_BIT(YEAR, 4),
+    S_BIT(YEAR, 5), S_BIT(YEAR, 6), S_BIT(YEAR, 7), S_PAR(36, 22), S_BLANK,
+};
+
+// IRIG-B004: 100 slots of 10 ms with BCD time of year, BCD year and
+// straight binary seconds of the day. The control functions are left
+// zero. Markers at 99 and 0, the leading edge of 0 is on time.
+static const struct wwv_slot wwv_slots_irigb[100] = {
+    S_MARK, S_BIT(SEC, 0), S_BIT(SEC, 1), S_BIT(SEC, 2), S_BIT(SEC, 3),
+    S_ZERO, S_BIT(SEC, 4), S_BIT(SEC, 5), S_BIT(SEC, 6), S_MARK,
+    S_BIT(MIN, 0), S_BIT(MIN, 1), S_BIT(MIN, 2), S_BIT(MIN, 3), S_ZERO,
+    S_BIT(MIN, 4), S_BIT(MIN, 5), S_BIT(MIN, 6), S_ZERO, S_MARK,
+    S_BIT(HOUR, 0), S_BIT(HOUR, 1), S_BIT(HOUR, 2), S_BIT(HOUR, 3), S_ZERO,
+    S_BIT(HOUR, 4), S_BIT(HOUR, 5), S_ZERO, S_ZERO, S_MARK,
+    S_BIT(YDAY, 0), S_BIT(YDAY, 1), S_BIT(YDAY, 2), S_BIT(YDAY, 3), S_ZERO,
+    S_BIT(YDAY, 4), S_BIT(YDAY, 5), S_BIT(YDAY, 6), S_BIT(YDAY, 7), S_MARK,
+    S_BIT(YDAY, 8), S_BIT(YDAY, 9), S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_MARK,
+    S_BIT(YEAR, 0), S_BIT(YEAR, 1), S_BIT(YEAR, 2), S_BIT(YEAR, 3), S_ZERO,
+    S_BIT(YEAR, 4), S_BIT(YEAR, 5), S_BIT(YEAR, 6), S_BIT(YEAR, 7), S_MARK,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_MARK,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_ZERO,
+    S_ZERO, S_ZERO, S_ZERO, S_ZERO, S_MARK,
+    S_BIN(SOD, 0), S_BIN(SOD, 1), S_BIN(SOD, 2), S_BIN(SOD, 3), S_BIN(SOD, 4),
+    S_BIN(SOD, 5), S_BIN(SOD, 6), S_BIN(SOD, 7), S_BIN(SOD, 8), S_MARK,
+    S_BIN(SOD, 9), S_BIN(SOD, 10), S_BIN(SOD, 11), S_BIN(SOD, 12), S_BIN(SOD, 13),
+    S_BIN(SOD, 14), S_BIN(SOD, 15), S_BIN(SOD, 16), S_ZERO, S_MARK,
+};
+
+static const struct wwv_proto wwv_proto_ece331 = {
+    .name = "ece331",
+    .level = WWV_LVL_CARRIER,
+    .slots = 60,
+    .period_us = 60000000,
+    .sym = {
+        [WWV_SYM_ZERO] = { ZBIT * WWV_CYCLE, ZDELAY },
+        [WWV_SYM_ONE] = { OBIT * WWV_CYCLE, ODELAY },
+        [WWV_SYM_MARKER] = { PINDEX * WWV_CYCLE, PDELAY },
+        [WWV_SYM_BLANK] = { 0, 1000000 },
+    },
+    .slot = wwv_slots_ece331,
+};
+
+static const struct wwv_proto wwv_proto_wwv = {
+    .name = "wwv",
+    .level = WWV_LVL_CARRIER,
+    .slots = 60,
+    .period_us = 60000000,
+    .sym = {
+        [WWV_SYM_ZERO] = { 170000, 800000, 30000 },
+        [WWV_SYM_ONE] = { 470000, 500000, 30000 },
+        [WWV_SYM_MARKER] = { 770000, 200000, 30000 },
+        [WWV_SYM_BLANK] = { 0, 1000000 },
+    },
+    .slot = wwv_slots_wwv,
+};
+
+// The pin is high while the carrier is at reduced power
+static const struct wwv_proto wwv_proto_wwvb = {
+    .name = "wwvb",
+    .level = WWV_LVL_HIGH,
+    .slots = 60,
+    .period_us = 60000000,
+    .sym = {
+        [WWV_SYM_ZERO] = { 200000, 800000 },
+        [WWV_SYM_ONE] = { 500000, 500000 },
+        [WWV_SYM_MARKER] = { 800000, 200000 },
+        [WWV_SYM_BLANK] = { 0, 1000000 },
+    },
+    .slot = wwv_slots_wwvb,
+};
+
+// The pin is high while the carrier is at reduced power
+static const struct wwv_proto wwv_proto_dcf77 = {
+    .name = "dcf77",
+    .level = WWV_LVL_HIGH,
+    .slots = 60,
+    .period_us = 60000000,
+    .sym = {
+        [WWV_SYM_ZERO] = { 100000, 900000 },
+        [WWV_SYM_ONE] = { 200000, 800000 },
+        [WWV_SYM_MARKER] = { 0, 0 },
+        [WWV_SYM_BLANK] = { 0, 1000000 },
+    },
+    .slot = wwv_slots_dcf77,
+};
+
+static const struct wwv_proto wwv_proto_irigb = {
+    .name = "irigb",
+    .level = WWV_LVL_HIGH,
+    .slots = 100,
+    .period_us = 1000000,
+    .sym = {
+        [WWV_SYM_ZERO] = { 2000, 8000 },
+        [WWV_SYM_ONE] = { 5000, 5000 },
+        [WWV_SYM_MARKER] = { 8000, 2000 },
+        [WWV_SYM_BLANK] = { 0, 10000 },
+    },
+    .slot = wwv_slots_irigb,
+};
+
+// Every layout, indexed by WWV_PROTO_*
+static const struct wwv_proto *const wwv_protos[] = {
+    [WWV_PROTO_ECE331] = &wwv_proto_ece331,
+    [WWV_PROTO_WWV] = &wwv_proto_wwv,
+    [WWV_PROTO_WWVB] = &wwv_proto_wwvb,
+    [WWV_PROTO_DCF77] = &wwv_proto_dcf77,
+    [WWV_PROTO_IRIGB] = &wwv_proto_irigb,
+};
+
+/*
+ * Returns the layout for a WWV_PROTO_* id, or NULL if there is none.
+ */
+const struct wwv_proto *wwv_proto_get(int id)
+{
+    if (id < 0 || id >= (int)(sizeof(wwv_protos) / sizeof(wwv_protos[0]))) return NULL;
+
+    return wwv_protos[id];
+}
+
+/*
+ * Returns the layout with the given name, or NULL if there is none.
+ */
+const struct wwv_proto *wwv_proto_find(const char *name)
+{
+    const struct wwv_proto *proto;
+    int i;
+
+    for (i = 0; (proto = wwv_proto_get(i)) != NULL; i++) {
+        if (strcmp(proto->name, name) == 0) return proto;
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns the WWV_PROTO_* id of a layout.
+ */
+int wwv_proto_id(const struct wwv_proto *proto)
+{
+    int i;
+
+    for (i = 0; wwv_proto_get(i) != NULL; i++) {
+        if (wwv_protos[i] == proto) return i;
+    }
+
+    return -1;
+}
+
+/*
+ * Returns 1 if year is a leap year.
+ */
+static int wwv_leap(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/* 
+ * Seperates year, minutes, hours and days into
+ * a wwv_date struct, with every field any layout
+ * sends. Retruns 0 if its a valid date,
+ * returns 1 otherwise. DST, DUT1 and the leap
+ * second warning are left 0 for the caller to set.
+ */
+int wwv_conv_date(struct tm *utc, struct wwv_date *dtime)
+{
+    static const int mdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    static const int mshift[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    int *f = dtime->field;
+    int year;
+    int yday;
+    int len;
+    int y;
+    int m;
+
+    // Checks if passed date values are valid
+    if (utc->tm_min > 59 || utc->tm_min < 0) return 1;
+    if (utc->tm_hour > 23 || utc->tm_hour < 0) return 1;
+    if (utc->tm_yday > 366 || utc->tm_yday < 0) return 1;
+    if (utc->tm_sec > 60 || utc->tm_sec < 0) return 1;
+
+    memset(dtime, 0, sizeof(struct wwv_date));
+    year = utc->tm_year + 1900;
+
+    f[WWV_F_SEC] = utc->tm_sec;
+    f[WWV_F_SOD] = utc->tm_hour * 3600 + utc->tm_min * 60 + utc->tm_sec;
+    f[WWV_F_MIN] = utc->tm_min;
+    f[WWV_F_HOUR] = utc->tm_hour;
+    f[WWV_F_YDAY] = utc->tm_yday;
+    f[WWV_F_YEAR] = ((year % 100) + 100) % 100;
+    f[WWV_F_LYI] = wwv_leap(year);
+    f[WWV_F_STD] = 1;
+    f[WWV_F_DUT1_POS] = 1;
+
+    // Month and day of the month for the layouts that send them. A day
+    // of year past the end of the year leaves them 0.
+    yday = utc->tm_yday;
+    for (m = 0; m < 12 && yday > 0; m++) {
+        len = mdays[m] + (m == 1 && wwv_leap(year));
+        if (yday <= len) {
+            f[WWV_F_MON] = m + 1;
+            f[WWV_F_MDAY] = yday;
+            break;
+        }
+        yday -= len;
+    }
+
+    // Day of the week, Monday is 1
+    if (f[WWV_F_MON] != 0) {
+        y = year - (f[WWV_F_MON] < 3);
+        f[WWV_F_WDAY] = (y + y / 4 - y / 100 + y / 400 + mshift[f[WWV_F_MON] - 1] + f[WWV_F_MDAY]) % 7;
+        if (f[WWV_F_WDAY] == 0) f[WWV_F_WDAY] = 7;
+    }
+    
+    return 0;
+}
+
+/*
+ * Converts a fixed size ABI timestamp into a wwv_date, including the
+ * DST, leap second and DUT1 flags. Returns 0 if it's a valid date,
+ * returns 1 otherwise.
+ */
+int wwv_conv_stamp(const struct wwv_stamp *stamp, struct wwv_date *dtime)
+{
+    struct tm utc;
+    int *f = dtime->field;
+
+    if (WWV_STAMP_DUT1_TENTHS(stamp->flags) > 9) return 1;
+
+    memset(&utc, 0, sizeof(utc));
+    utc.tm_year = stamp->year - 1900;
+    utc.tm_yday = stamp->yday;
+    utc.tm_hour = stamp->hour;
+    utc.tm_min = stamp->min;
+    utc.tm_sec = stamp->sec;
+
+    if (wwv_conv_date(&utc, dtime)) return 1;
+
+    f[WWV_F_DST1] = !!(stamp->flags & WWV_STAMP_DST1);
+    f[WWV_F_DST2] = !!(stamp->flags & WWV_STAMP_DST2);
+    f[WWV_F_STD] = !f[WWV_F_DST1];
+    f[WWV_F_LSW] = !!(stamp->flags & WWV_STAMP_LSW);
+    f[WWV_F_DUT1] = WWV_STAMP_DUT1_TENTHS(stamp->flags);
+    f[WWV_F_DUT1_NEG] = !!(stamp->flags & WWV_STAMP_DUT1_NEG);
+    f[WWV_F_DUT1_POS] = !f[WWV_F_DUT1_NEG];
+
+    return 0;
+}
+
+/*
+ * Reads exactly n decimal digits at *p into *val and moves *p past
+ * them. Returns 0 on success, 1 otherwise.
+ */
+static int wwv_digits(const char **p, const char *end, int n, int *val)
+{
+    *val = 0;
+    for (; n > 0; n--, (*p)++) {
+        if (*p == end || **p < '0' || **p > '9') return 1;
+        *val = *val * 10 + (**p - '0');
+    }
+
+    return 0;
+}
+
+/*
+ * Parses a UTC time in ISO 8601 form, YYYY-MM-DDTHH:MM[:SS][Z] or
+ * with an ordinal date YYYY-DDDTHH:MM[:SS][Z]. A space may stand in
+ * for the T. The text need not be NUL terminated. Only the form is
+ * checked here, the ranges are left to wwv_conv_date(). Returns 0 on
+ * success, 1 otherwise.
+ */
+int wwv_parse_iso(const char *s, int len, struct wwv_stamp *stamp)
+{
+    static const int before[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    const char *p = s;
+    const char *end = s + len;
+    int year;
+    int yday;
+    int mon;
+    int mday;
+    int hour;
+    int min;
+    int sec = 0;
+
+    // Leading year, then an ordinal or a calendar date
+    if (wwv_digits(&p, end, 4, &year) || p == end || *p++ != '-') return 1;
+
+    // MM-DD is a calendar date, three digits an ordinal one
+    if (end - p < 3 || p[2] != '-') {
+        if (wwv_digits(&p, end, 3, &yday)) return 1;
+    } else {
+        if (wwv_digits(&p, end, 2, &mon) || p == end || *p++ != '-') return 1;
+        if (wwv_digits(&p, end, 2, &mday)) return 1;
+        if (mon < 1 || mon > 12 || mday < 1) return 1;
+        if (mday > (mon == 12 ? 365 : before[mon]) - before[mon - 1] + (mon == 2 && wwv_leap(year))) return 1;
+        yday = before[mon - 1] + mday + (mon > 2 && wwv_leap(year));
+    }
+
+    if (p == end || (*p != 'T' && *p != ' ')) return 1;
+    p++;
+    if (wwv_digits(&p, end, 2, &hour) || p == end || *p++ != ':') return 1;
+    if (wwv_digits(&p, end, 2, &min)) return 1;
+    if (p != end && *p == ':') {
+        p++;
+        if (wwv_digits(&p, end, 2, &sec)) return 1;
+    }
+    if (p != end && *p == 'Z') p++;
+    if (p != end) return 1;
+
+    memset(stamp, 0, sizeof(*stamp));
+    stamp->year = year;
+    stamp->yday = yday;
+    stamp->hour = hour;
+    stamp->min = min;
+    stamp->sec = sec;
+
+    return 0;
+}
+
+/*
+ * Returns a field's value as packed BCD, one digit per 4 bits.
+ */
+static int wwv_bcd(int val)
+{
+    return (val % 10) | ((val / 10 % 10) << 4) | ((val / 100 % 10) << 8);
+}
+
+/*
+ * Packs every field of a date as BCD.
+ */
+static void wwv_date_bcd(const struct wwv_date *dtime, int *bcd)
+{
+    int i;
+
+    for (i = 0; i < WWV_FIELDS; i++) bcd[i] = wwv_bcd(dtime->field[i]);
+}
+
+/*
+ * Returns the WWV_SYM_* a slot is sent as, given the date and its
+ * fields already packed as BCD.
+ */
+static int wwv_slot_sym_bcd(const struct wwv_proto *proto, int slot, const struct wwv_date *dtime, const int *bcd)
+{
+    const struct wwv_slot *s = &proto->slot[slot];
+    int ones = 0;
+    int i;
+
+    switch (s->kind) {
+        case WWV_SLOT_ZERO:
+            return WWV_SYM_ZERO;
+
+        case WWV_SLOT_ONE:
+            return WWV_SYM_ONE;
+
+        case WWV_SLOT_MARKER:
+            return WWV_SYM_MARKER;
+
+        case WWV_SLOT_FIELD:
+            return (bcd[s->field] >> s->bit) & 1 ? WWV_SYM_ONE : WWV_SYM_ZERO;
+
+        case WWV_SLOT_BINARY:
+            return (dtime->field[s->field] >> s->bit) & 1 ? WWV_SYM_ONE : WWV_SYM_ZERO;
+
+        case WWV_SLOT_PARITY:
+            // Makes the number of ones over the run and this bit even
+            for (i = s->field; i < s->field + s->bit; i++) {
+                if (wwv_slot_sym_bcd(proto, i, dtime, bcd) == WWV_SYM_ONE) ones++;
+            }
+            return (ones & 1) ? WWV_SYM_ONE : WWV_SYM_ZERO;
+
+        default:
+            return WWV_SYM_BLANK;
+    }
+}
+
+/*
+ * Returns the WWV_SYM_* a slot of the layout is sent as for a date.
+ */
+int wwv_slot_sym(const struct wwv_proto *proto, int slot, const struct wwv_date *dtime)
+{
+    int bcd[WWV_FIELDS];
+
+    wwv_date_bcd(dtime, bcd);
+
+    return wwv_slot_sym_bcd(proto, slot, dtime, bcd);
+}
+
+/*
+ * Appends a run to the schedule. Back to back runs at the same
+ * level are merged so the player has fewer entries to walk.
+ * Returns 0 on success, 1 if the schedule is full.
+ */
+static int wwv_sched_add(struct wwv_sched *sched, int level, u32 usecs)
+{
+    struct wwv_run *last;
+
+    if (usecs == 0) return 0;
+
+    if (sched->len > 0) {
+        last = &sched->run[sched->len - 1];
+        // A sum that would wrap around starts a run of its own
+        if (last->level == level && level != WWV_LVL_CARRIER && last->usecs + usecs > last->usecs) {
+            last->usecs += usecs;
+            return 0;
+        }
+    }
+
+    if (sched->len >= WWV_SCHED_MAX) return 1;
+
+    sched->run[sched->len].level = level;
+    sched->run[sched->len].usecs = usecs;
+    sched->len++;
+
+    return 0;
+}
+
+/*
+ * Adds one symbol to the schedule: the lead in, the pulse at the
+ * layout's level, then a rest.
+ */
+static int wwv_sched_sym(struct wwv_sched *sched, int level, const struct wwv_sym *sym)
+{
+    if (wwv_sched_add(sched, WWV_LVL_LOW, sym->lead_us)) return 1;
+    if (wwv_sched_add(sched, level, sym->on_us)) return 1;
+    return wwv_sched_add(sched, WWV_LVL_LOW, sym->off_us);
+}
+
+/*
+ * Compiles a whole frame for the date into a schedule of runs by
+ * walking the layout one second at a time. Nothing here touches the
+ * pin, so it can be done before the timing critical part starts.
+ * Returns 0 on success, 1 if the frame did not fit.
+ */
+int wwv_enc_frame(struct wwv_sched *sched, const struct wwv_proto *proto, const struct wwv_date *dtime)
+{
+    int bcd[WWV_FIELDS];
+    int ret = 0;
+    int i;
+
+    sched->proto = proto;
+    sched->len = 0;
+
+    wwv_date_bcd(dtime, bcd);
+    for (i = 0; i < proto->slots; i++)
+        ret |= wwv_sched_sym(sched, proto->level, &proto->sym[wwv_slot_sym_bcd(proto, i, dtime, bcd)]);
+
+    return ret;
+}
+
+/*
+ * Compiles a frame in the ECE331 board's layout.
+ */
+int wwv_enc_date(struct wwv_sched *sched, struct wwv_date *dtime)
+{
+    return wwv_enc_frame(sched, &wwv_proto_ece331, dtime);
+}
+
+/*
+ * Loads a waveform built in userspace into a schedule, checking every
+ * run on the way. The schedule has no layout, so its pulses aren't
+ * sorted into symbols. Returns 0 on success, 1 if the waveform is not
+ * valid.
+ */
+int wwv_rle_load(struct wwv_sched *sched, const struct wwv_rle *rle)
+{
+    static const u8 level[] = {
+        [WWV_RLE_LOW] = WWV_LVL_LOW,
+        [WWV_RLE_HIGH] = WWV_LVL_HIGH,
+        [WWV_RLE_CARRIER] = WWV_LVL_CARRIER,
+    };
+    const struct wwv_rle_run *run;
+    u32 i;
+
+    sched->proto = NULL;
+    sched->len = 0;
+
+    if (rle->version != WWV_RLE_VERSION || rle->count == 0 || rle->count > WWV_RLE_MAX) return 1;
+
+    for (i = 0; i < rle->count; i++) {
+        run = &rle->run[i];
+        if (run->level > WWV_RLE_CARRIER || run->usecs < WWV_RLE_MIN_US) return 1;
+
+        // The player flips a burst every half cycle and needs it to
+        // end low
+        if (run->level == WWV_RLE_CARRIER && run->usecs % WWV_CYCLE) return 1;
+
+        if (wwv_sched_add(sched, level[run->level], run->usecs)) return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns the length of a schedule in ns.
+ */
+u64 wwv_sched_ns(const struct wwv_sched *sched)
+{
+    u64 ns = 0;
+    int i;
+
+    for (i = 0; i < sched->len; i++) ns += (u64)sched->run[i].usecs * 1000;
+
+    return ns;
+}
+
+/*
+ * Points a cursor at the first edge of a schedule. Every time in the
+ * schedule, the subcarrier's cycle included, is divided by scale so a
+ * frame can be sent faster for testing. 0 and 1 mean real time.
+ */
+void wwv_cursor_init(struct wwv_cursor *cur, const struct wwv_sched *sched, u32 scale)
+{
+    cur->sched = sched;
+    cur->idx = 0;
+    cur->half = 0;
+    cur->level = 0;
+    cur->scale = scale ? scale : 1;
+    cur->raw = 0;
+    cur->t = 0;
+}
+
+/*
+ * Takes the edge due at cur->t. Afterwards cur->level is the level
+ * the pin should go to now and cur->t is the time of the edge after
+ * it. Returns 1 once the schedule is finished, with cur->level low,
+ * and 0 otherwise.
+ */
+int wwv_cursor_step(struct wwv_cursor *cur)
+{
+    const struct wwv_run *run;
+
+    // Inside a subcarrier burst, flip every half cycle
+    if (cur->half > 0) {
+        cur->level = !cur->level;
+        cur->half--;
+        cur->raw += (u64)WWV_CYCLE / 2 * 1000;
+        goto scale;
+    }
+
+    if (cur->idx >= cur->sched->len) {
+        cur->level = 0;
+        return 1;
+    }
+
+    // Start the next run
+    run = &cur->sched->run[cur->idx++];
+    switch (run->level) {
+        case WWV_LVL_CARRIER:
+            cur->level = 1;
+            cur->half = run->usecs / (WWV_CYCLE / 2) - 1;
+            cur->raw += (u64)WWV_CYCLE / 2 * 1000;
+            break;
+
+        case WWV_LVL_HIGH:
+            cur->level = 1;
+            cur->raw += (u64)run->usecs * 1000;
+            break;
+
+        default:
+            cur->level = 0;
+            cur->raw += (u64)run->usecs * 1000;
+            break;
+    }
+
+scale:
+    // Scaled from the frame start, not per run, so rounding never adds up
+    cur->t = cur->scale == 1 ? cur->raw : div_u64(cur->raw, cur->scale);
+    return 0;
+}
+
+/*
+ * Plays a schedule through a backend. Each edge is placed at its time
+ * from the start of the frame, so how long the backend takes does not
+ * add up across the frame.
+ */
+int wwv_play(const struct wwv_sched *sched, const struct wwv_backend *be)
+{
+    return wwv_play_scaled(sched, be, 1);
+}
+
+/*
+ * Same as wwv_play() with every time divided by scale.
+ */
+int wwv_play_scaled(const struct wwv_sched *sched, const struct wwv_backend *be, u32 scale)
+{
+    struct wwv_cursor cur;
+    int done;
+
+    wwv_cursor_init(&cur, sched, scale);
+    do {
+        be->wait_until(be->ctx, cur.t);
+        done = wwv_cursor_step(&cur);
+        be->set_pin(be->ctx, cur.level);
+    } while (!done);
+
+    return 0;
+}
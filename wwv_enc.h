@@ -0,0 +1,176 @@
+// Encoder core for the WWV time/date transmitter
+
+/*
+ * Eric Sullivan
+ * Builds both in the kernel driver and as the userspace libwwv.a,
+ * so nothing in here may touch a pin or sleep.
+ */
+#ifndef WWV_ENC_H
+#define WWV_ENC_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/time.h>
+#else
+#include <stdint.h>
+#include <time.h>
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+#endif
+
+// Macros for delays of the ECE331 board's frame: 18, 48 and 78 cycles
+// of subcarrier, then the rest of the second. Each pulse and its delay
+// add up to exactly one second, so a frame is exactly a minute.
+#define ZBIT 18
+#define OBIT 48
+#define PINDEX 78
+#define ZDELAY 820000
+#define ODELAY 520000
+#define PDELAY 220000
+
+// Length of one 100 Hz subcarrier cycle in usecs
+#define WWV_CYCLE 10000
+
+// Levels a schedule run can hold the pin at
+#define WWV_LVL_LOW 0		// Pin held low
+#define WWV_LVL_HIGH 1		// Pin held high
+#define WWV_LVL_CARRIER 2	// 100 Hz subcarrier on the pin
+
+// Most runs a compiled frame can hold. An IRIG-B frame needs 200,
+// and a waveform from WWV_TRANSMIT_RLE up to WWV_RLE_MAX.
+#define WWV_SCHED_MAX 208
+
+// Most slots in a frame layout
+#define WWV_SLOTS_MAX 100
+
+// Symbols a second of a frame can be sent as
+#define WWV_SYM_ZERO 0		// Short pulse
+#define WWV_SYM_ONE 1		// Longer pulse
+#define WWV_SYM_MARKER 2	// Longest pulse, position marker
+#define WWV_SYM_BLANK 3		// No pulse at all
+#define WWV_SYMS 4
+
+// What a slot of a frame layout carries
+#define WWV_SLOT_BLANK 0	// Nothing, the pin stays low
+#define WWV_SLOT_ZERO 1		// Always a zero
+#define WWV_SLOT_ONE 2		// Always a one
+#define WWV_SLOT_MARKER 3	// Position marker
+#define WWV_SLOT_FIELD 4	// One bit of a field's BCD value
+#define WWV_SLOT_PARITY 5	// Even parity over a run of field slots
+#define WWV_SLOT_BINARY 6	// One bit of a field's straight binary value
+
+// Fields a frame can carry, index into wwv_date.field[]
+#define WWV_F_MIN 0		// Minute, 0-59
+#define WWV_F_HOUR 1		// Hour, 0-23
+#define WWV_F_YDAY 2		// Day of year, counted from 1
+#define WWV_F_YEAR 3		// Year of the century, 0-99
+#define WWV_F_MDAY 4		// Day of the month, 1-31
+#define WWV_F_MON 5		// Month, 1-12
+#define WWV_F_WDAY 6		// Day of the week, 1 for Monday to 7 for Sunday
+#define WWV_F_DST1 7		// DST in effect at 24:00 UTC today
+#define WWV_F_DST2 8		// DST in effect at 00:00 UTC today
+#define WWV_F_STD 9		// DST1 not set
+#define WWV_F_LSW 10		// Leap second at the end of the month
+#define WWV_F_LYI 11		// Leap year
+#define WWV_F_DUT1 12		// Size of UT1 - UTC in tenths of a second, 0-9
+#define WWV_F_DUT1_POS 13	// UT1 - UTC is zero or above
+#define WWV_F_DUT1_NEG 14	// UT1 - UTC is below zero
+#define WWV_F_SEC 15		// Second, 0-60
+#define WWV_F_SOD 16		// Second of the day
+#define WWV_FIELDS 17
+
+// Date and flags to send, in every form any frame layout needs
+struct wwv_date {
+    int field[WWV_FIELDS];	// Value of each WWV_F_* field
+};
+
+// How a symbol is sent: the pin low for the lead in, the pulse, then
+// the pin low for the rest
+struct wwv_sym {
+    u32 on_us;			// Pulse length, 0 for no pulse
+    u32 off_us;			// Low time after it
+    u32 lead_us;		// Low time from the start of the second to the pulse
+};
+
+// One second of a frame layout
+struct wwv_slot {
+    u8 kind;			// WWV_SLOT_* value
+    u8 field;			// WWV_F_* field, or first slot covered by a parity bit
+    u8 bit;			// Bit of the field's value, or slots covered by a parity bit
+};
+
+// A timecode format: how each symbol goes out on the pin and what
+// each slot of the frame carries
+struct wwv_proto {
+    const char *name;		// Name used by sysfs and the tools
+    u8 level;			// WWV_LVL_* the pin is at during a pulse
+    int slots;			// Slots in a frame
+    u32 period_us;		// Time one frame covers, frames start on a multiple of it
+    struct wwv_sym sym[WWV_SYMS];	// Indexed by WWV_SYM_*
+    const struct wwv_slot *slot;	// What each slot carries
+};
+
+// One run of a frame schedule: a level held for a duration
+struct wwv_run {
+    u32 usecs;			// Length of the run
+    u8 level;			// WWV_LVL_* value
+};
+
+// A whole frame compiled into runs, ready to be played out
+struct wwv_sched {
+    const struct wwv_proto *proto;	// Layout it was compiled from
+    int len;			// Runs in use
+    struct wwv_run run[WWV_SCHED_MAX];
+};
+
+// Walks a schedule one pin edge at a time
+struct wwv_cursor {
+    const struct wwv_sched *sched;	// Schedule being walked
+    int idx;			// Next run to start
+    int half;			// Half cycles left in the current burst
+    int level;			// Pin level from t on
+    u32 scale;			// Times are divided by this, 1 for real time
+    u64 raw;			// Time of the next edge before scaling
+    u64 t;			// Time of the next edge in ns from the frame start
+};
+
+// Pin and clock backend that wwv_play() drives
+struct wwv_backend {
+    void (*set_pin)(void *ctx, int level);	// Set the pin level
+    void (*wait_until)(void *ctx, u64 t);	// Wait until t ns after the frame start
+    void *ctx;			// Passed back to both calls
+};
+
+// Trace file header magic and version. A trace file is the magic,
+// the version as a u32, then struct wwv_edge records.
+#define WWV_TRACE_MAGIC "WWVT"
+#define WWV_TRACE_VERSION 1
+
+// One pin transition in a recorded trace
+struct wwv_edge {
+    u64 t;			// ns from the start of the trace
+    u32 level;			// Level the pin went to
+    u32 pad;
+};
+
+struct wwv_stamp;
+struct wwv_rle;
+
+const struct wwv_proto *wwv_proto_get(int id);
+const struct wwv_proto *wwv_proto_find(const char *name);
+int wwv_proto_id(const struct wwv_proto *proto);
+int wwv_slot_sym(const struct wwv_proto *proto, int slot, const struct wwv_date *dtime);
+int wwv_conv_date(struct tm *utc, struct wwv_date *dtime);
+int wwv_conv_stamp(const struct wwv_stamp *stamp, struct wwv_date *dtime);
+int wwv_parse_iso(const char *s, int len, struct wwv_stamp *stamp);
+int wwv_enc_frame(struct wwv_sched *sched, const struct wwv_proto *proto, const struct wwv_date *dtime);
+int wwv_enc_date(struct wwv_sched *sched, struct wwv_date *dtime);
+int wwv_rle_load(struct wwv_sched *sched, const struct wwv_rle *rle);
+u64 wwv_sched_ns(const struct wwv_sched *sched);
+void wwv_cursor_init(struct wwv_cursor *cur, const struct wwv_sched *sched, u32 scale);
+int wwv_cursor_step(struct wwv_cursor *cur);
+int wwv_play(const struct wwv_sched *sched, const struct wwv_backend *be);
+int wwv_play_scaled(const struct wwv_sched *sched, const struct wwv_backend *be, u32 scale);
+
+#endif	// WWV_ENC_H
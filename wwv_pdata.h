@@ -0,0 +1,19 @@
+// Platform data for the WWV transmitter driver
+
+/*
+ * Eric Sullivan
+ * Lets the driver be probed without a device tree node, e.g. by
+ * wwv_sim on a gpio-mockup chip. Pins are global GPIO numbers.
+ */
+#ifndef WWV_PDATA_H
+#define WWV_PDATA_H
+
+// Output pins, in the order of the DT children they stand in for
+#define WWV_PDATA_PINS 4
+
+struct wwv_platform_data {
+    int shutdown;		// Shutdown input
+    int pins[WWV_PDATA_PINS];	// WWV, Unused17, Unused18 and Unused22 outputs
+};
+
+#endif	// WWV_PDATA_H
@@ -0,0 +1,60 @@
+// Direct GPIO register access for the WWV transmitter
+
+/*
+ * Eric Sullivan
+ * Sets a BCM283x output pin by writing its bit to GPSETn or GPCLRn,
+ * skipping gpiolib on the hot path. Header only so the driver and
+ * the userspace tests share it. The tests point it at a mock
+ * register block in memory.
+ */
+#ifndef WWV_PIN_H
+#define WWV_PIN_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/io.h>
+#else
+#include <stdint.h>
+#define __iomem
+#define writel_relaxed(v, a) (*(volatile uint32_t *)(a) = (v))
+#endif
+
+// BCM283x GPIO register block. Each set/clear register covers 32 pins
+// and a 1 bit only touches its own pin.
+#define WWV_GPSET0 0x1c		// Output set, pins 0-31
+#define WWV_GPCLR0 0x28		// Output clear, pins 0-31
+#define WWV_GPIO_PINS 54	// Pins in the block
+#define WWV_GPIO_REGS 0xb4	// Size of the block in bytes
+
+// A pin driven through the register block
+struct wwv_mmio_pin {
+    void __iomem *set;		// GPSETn holding the pin
+    void __iomem *clr;		// GPCLRn holding the pin
+    uint32_t mask;		// The pin's bit in both
+};
+
+/*
+ * Points a pin at its registers in the block mapped at base.
+ * Returns 0 on success, 1 if the block has no such pin.
+ */
+static inline int wwv_mmio_pin_init(struct wwv_mmio_pin *mp, void __iomem *base, unsigned int gpio)
+{
+    if (gpio >= WWV_GPIO_PINS) return 1;
+
+    mp->set = (char __iomem *)base + WWV_GPSET0 + gpio / 32 * 4;
+    mp->clr = (char __iomem *)base + WWV_GPCLR0 + gpio / 32 * 4;
+    mp->mask = 1U << (gpio % 32);
+
+    return 0;
+}
+
+/*
+ * Sets the pin. One posted write, no locking needed since the
+ * registers are write-1-to-act.
+ */
+static inline void wwv_mmio_pin_set(const struct wwv_mmio_pin *mp, int level)
+{
+    writel_relaxed(mp->mask, level ? mp->set : mp->clr);
+}
+
+#endif	// WWV_PIN_H
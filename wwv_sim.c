@@ -0,0 +1,69 @@
+// Simulated board for the WWV transmitter driver
+
+/*
+ * Eric Sullivan
+ * Registers a bcm2835-wwv platform device whose pins are lines of a
+ * gpio-mockup (or gpio-sim) chip, so wwv.ko can be loaded, driven
+ * and benchmarked on a normal Linux host with no Pi and no expansion
+ * board. Line 0 of the chip is Shutdown and lines 1-4 are the WWV,
+ * Unused17, Unused18 and Unused22 outputs.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/string.h>
+#include <linux/platform_device.h>
+#include <linux/gpio/driver.h>
+
+#include "wwv_pdata.h"
+
+// Label of the chip the pins are on
+static char *chip = "gpio-mockup-A";
+module_param(chip, charp, 0444);
+MODULE_PARM_DESC(chip, "Label of the GPIO chip to put the pins on");
+
+static struct platform_device *wwv_sim_pdev;
+
+// Finds the chip by its label
+static int wwv_sim_match(struct gpio_chip *gc, void *data)
+{
+    return gc->label != NULL && strcmp(gc->label, data) == 0;
+}
+
+static int __init wwv_sim_init(void)
+{
+    struct wwv_platform_data pd;
+    struct gpio_chip *gc;
+    int i;
+
+    gc = gpiochip_find(chip, wwv_sim_match);
+    if (gc == NULL) {
+        printk(KERN_INFO "wwv_sim: no GPIO chip %s\n", chip);
+        return -ENODEV;
+    }
+    if (gc->ngpio < WWV_PDATA_PINS + 1) {
+        printk(KERN_INFO "wwv_sim: %s needs %d lines\n", chip, WWV_PDATA_PINS + 1);
+        return -ENODEV;
+    }
+
+    pd.shutdown = gc->base;
+    for (i = 0; i < WWV_PDATA_PINS; i++) pd.pins[i] = gc->base + 1 + i;
+
+    // Matches the driver by name, the platform data is copied
+    wwv_sim_pdev = platform_device_register_data(NULL, "bcm2835-wwv", PLATFORM_DEVID_AUTO, &pd, sizeof(pd));
+    if (IS_ERR(wwv_sim_pdev)) return PTR_ERR(wwv_sim_pdev);
+
+    printk(KERN_INFO "wwv_sim: pins on %s from GPIO %d\n", chip, gc->base);
+    return 0;
+}
+
+static void __exit wwv_sim_exit(void)
+{
+    platform_device_unregister(wwv_sim_pdev);
+}
+
+module_init(wwv_sim_init);
+module_exit(wwv_sim_exit);
+
+MODULE_DESCRIPTION("Simulated board for the WWV driver");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,139 @@
+// Tracepoints for the WWV transmitter
+
+/*
+ * Eric Sullivan
+ * Follows a frame from the call that hands it over, through the wait
+ * for the pin, to every pulse the engine puts out and the end of the
+ * frame. Each event costs a patched-out branch until it's turned on
+ * in events/wwv/ under tracefs, or with perf record -e 'wwv:*'.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM wwv
+
+#if !defined(WWV_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define WWV_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// How a frame was handed to the driver
+#define WWV_TR_TRANSMIT 0	// WWV_TRANSMIT
+#define WWV_TR_AT 1		// WWV_TRANSMIT_AT
+#define WWV_TR_QUEUE 2		// WWV_SUBMIT, WWV_TRANSMIT_BATCH or write()
+#define WWV_TR_URGENT 3		// WWV_SUBMIT_URGENT
+#define WWV_TR_RLE 4		// WWV_TRANSMIT_RLE
+
+TRACE_EVENT(wwv_submit,
+    TP_PROTO(int minor, int how, unsigned int count),
+    TP_ARGS(minor, how, count),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, how)
+        __field(unsigned int, count)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->how = how;
+        __entry->count = count;
+    ),
+    TP_printk("wwv%d %s frames=%u", __entry->minor,
+        __print_symbolic(__entry->how,
+            { WWV_TR_TRANSMIT, "transmit" },
+            { WWV_TR_AT, "transmit_at" },
+            { WWV_TR_QUEUE, "queue" },
+            { WWV_TR_URGENT, "urgent" },
+            { WWV_TR_RLE, "rle" }),
+        __entry->count)
+);
+
+// The pin was taken, or the wait for it failed
+TRACE_EVENT(wwv_admit,
+    TP_PROTO(int minor, u64 wait_ns, int ret),
+    TP_ARGS(minor, wait_ns, ret),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(u64, wait_ns)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->wait_ns = wait_ns;
+        __entry->ret = ret;
+    ),
+    TP_printk("wwv%d wait_ns=%llu ret=%d", __entry->minor, __entry->wait_ns, __entry->ret)
+);
+
+// First edge of a frame, against the time it was armed for
+TRACE_EVENT(wwv_frame_start,
+    TP_PROTO(int minor, s64 sched_ns, s64 actual_ns, u32 scale),
+    TP_ARGS(minor, sched_ns, actual_ns, scale),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(s64, sched_ns)
+        __field(s64, actual_ns)
+        __field(u32, scale)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->sched_ns = sched_ns;
+        __entry->actual_ns = actual_ns;
+        __entry->scale = scale;
+    ),
+    TP_printk("wwv%d sched=%lld late_ns=%lld scale=%u", __entry->minor, __entry->sched_ns,
+        __entry->actual_ns - __entry->sched_ns, __entry->scale)
+);
+
+// Start of the pulse of a bit or marker
+TRACE_EVENT(wwv_symbol,
+    TP_PROTO(int minor, int run, int sym, s64 sched_ns, s64 actual_ns),
+    TP_ARGS(minor, run, sym, sched_ns, actual_ns),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, run)
+        __field(int, sym)
+        __field(s64, sched_ns)
+        __field(s64, actual_ns)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->run = run;
+        __entry->sym = sym;
+        __entry->sched_ns = sched_ns;
+        __entry->actual_ns = actual_ns;
+    ),
+    TP_printk("wwv%d run=%d %s sched=%lld late_ns=%lld", __entry->minor, __entry->run,
+        __print_symbolic(__entry->sym,
+            { WWV_SYM_ZERO, "zero" },
+            { WWV_SYM_ONE, "one" },
+            { WWV_SYM_MARKER, "marker" },
+            { WWV_SYM_BLANK, "blank" }),
+        __entry->sched_ns, __entry->actual_ns - __entry->sched_ns)
+);
+
+// Last edge of a frame, cut is set if it was stopped early
+TRACE_EVENT(wwv_frame_end,
+    TP_PROTO(int minor, s64 start_ns, s64 end_ns, int cut),
+    TP_ARGS(minor, start_ns, end_ns, cut),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(s64, start_ns)
+        __field(s64, end_ns)
+        __field(int, cut)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->start_ns = start_ns;
+        __entry->end_ns = end_ns;
+        __entry->cut = cut;
+    ),
+    TP_printk("wwv%d len_ns=%lld%s", __entry->minor, __entry->end_ns - __entry->start_ns,
+        __entry->cut ? " cut" : "")
+);
+
+#endif	// WWV_TRACE_H
+
+// The header is read again from the module's own directory
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE wwv_trace
+#include <trace/define_trace.h>